@@ -19,17 +19,75 @@ SOURCES += main.cpp\
     file_system_model.cpp \
     proxy_item_delegate.cpp \
     dir_scaner.cpp \
-    reg_exp_dialog.cpp
+    reg_exp_dialog.cpp \
+    filter_model.cpp \
+    filter_scaner.cpp \
+    file_stat.cpp \
+    refresh_scaner.cpp \
+    name_pool.cpp \
+    entry_info.cpp \
+    exporter.cpp \
+    ignore_rules.cpp \
+    file_operation_task.cpp \
+    file_operation_queue.cpp \
+    scan_scheduler.cpp \
+    snapshot.cpp \
+    snapshot_diff.cpp \
+    diff_model.cpp \
+    archive_index.cpp \
+    archive_scaner.cpp \
+    hash_cache.cpp \
+    hash_service.cpp \
+    type_detector.cpp \
+    parallel_crawler.cpp \
+    stats_panel.cpp \
+    name_matcher.cpp
 
 HEADERS  += mainwindow.hpp \
     macros.hpp \
     file_system_model.hpp \
     proxy_item_delegate.hpp \
     dir_scaner.hpp \
-    reg_exp_dialog.hpp
+    reg_exp_dialog.hpp \
+    filter_model.hpp \
+    filter_scaner.hpp \
+    file_stat.hpp \
+    refresh_scaner.hpp \
+    chunked_vector.hpp \
+    name_pool.hpp \
+    entry_info.hpp \
+    exporter.hpp \
+    ignore_rules.hpp \
+    file_operation_task.hpp \
+    file_operation_queue.hpp \
+    scan_scheduler.hpp \
+    snapshot.hpp \
+    snapshot_diff.hpp \
+    diff_model.hpp \
+    archive_index.hpp \
+    archive_scaner.hpp \
+    hash_cache.hpp \
+    hash_service.hpp \
+    type_detector.hpp \
+    parallel_crawler.hpp \
+    stats_panel.hpp \
+    name_matcher.hpp
 
 FORMS    += mainwindow.ui \
     regexpdialog.ui
 
+# compressed tars are browsable only when the decompressor is found
+packagesExist(zlib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+    DEFINES += LOOKFOR_ZLIB
+}
+
+packagesExist(libzstd) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libzstd
+    DEFINES += LOOKFOR_ZSTD
+}
+
 RESOURCES += \
     assets.qrc
@@ -0,0 +1,781 @@
+#include "archive_index.hpp"
+#include "file_stat.hpp"
+
+#include <QDateTime>
+#include <QFile>
+#include <QMutex>
+#include <QStringList>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef LOOKFOR_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef LOOKFOR_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+
+qint64 const TarBlockSize = 512;
+/// GNU long names and pax headers are read into memory, anything bigger is a broken archive
+qint64 const MaxTarMetadataSize = 1024 * 1024;
+qint64 const InputBufferSize = 256 * 1024;
+/// Cached indices are dropped, least recently used first, when they hold more entries than this
+size_t const MaxCachedEntries = 2 * 1000 * 1000;
+
+quint16 UnixToPermissions(quint32 mode)
+{
+  // QFile::Permissions keeps read, write and exec in the same order as the unix mode,
+  // the owner bits are repeated for the user
+  quint32 const owner = (mode >> 6) & 7;
+  quint32 const group = (mode >> 3) & 7;
+  quint32 const other = mode & 7;
+  return static_cast<quint16>(owner << 12 | owner << 8 | group << 4 | other);
+}
+
+/// Fills the index from member paths in any order, the later of two equal members wins
+class IndexBuilder
+{
+public:
+  explicit IndexBuilder(ArchiveIndex & index)
+    : m_index(index)
+  {
+    m_index.m_entries.resize(1);
+    m_index.m_entries[0].m_isDir = true;
+    m_index.m_dirs.insert(QString(), 0);
+  }
+
+  void Add(QString const & path, bool isDir, qint64 size, qint64 modifiedTime, quint16 permissions)
+  {
+    QStringList parts = QString(path).replace('\\', '/').split('/', QString::SkipEmptyParts);
+    parts.removeAll(QStringLiteral("."));
+    // members outside the archive root are never shown
+    if (parts.isEmpty() || parts.contains(QStringLiteral("..")))
+      return;
+
+    QString const name = parts.takeLast();
+    QString const parentPath = parts.join('/');
+    QString const fullPath = parentPath.isEmpty() ? name : parentPath + '/' + name;
+
+    quint32 index = 0;
+    QHash<QString, quint32>::const_iterator it = m_paths.constFind(fullPath);
+    if (it != m_paths.constEnd())
+    {
+      index = it.value();
+      if (m_index.m_entries[index].m_isDir != isDir)
+        return;
+    }
+    else
+      index = AddEntry(EnsureDir(parentPath), name, fullPath, isDir);
+
+    ArchiveEntry & entry = m_index.m_entries[index];
+    entry.m_size = isDir ? 0 : size;
+    entry.m_modifiedTime = modifiedTime;
+    entry.m_permissions = permissions;
+  }
+
+private:
+  quint32 EnsureDir(QString const & path)
+  {
+    QHash<QString, quint32>::const_iterator it = m_index.m_dirs.constFind(path);
+    if (it != m_index.m_dirs.constEnd())
+      return it.value();
+
+    // a file and a directory of the same name, the directory goes to the top level instead
+    if (m_paths.contains(path))
+      return 0;
+
+    int const slash = path.lastIndexOf('/');
+    quint32 const parent = slash < 0 ? 0 : EnsureDir(path.left(slash));
+    return AddEntry(parent, path.mid(slash + 1), path, true);
+  }
+
+  quint32 AddEntry(quint32 parent, QString const & name, QString const & fullPath, bool isDir)
+  {
+    quint32 const index = static_cast<quint32>(m_index.m_entries.size());
+    m_index.m_entries.push_back(ArchiveEntry());
+    ArchiveEntry & entry = m_index.m_entries.back();
+    entry.m_name = name;
+    entry.m_isDir = isDir;
+
+    m_index.m_entries[parent].m_children.push_back(index);
+    m_paths.insert(fullPath, index);
+    if (isDir)
+      m_index.m_dirs.insert(fullPath, index);
+
+    return index;
+  }
+
+  ArchiveIndex & m_index;
+  QHash<QString, quint32> m_paths;
+};
+
+quint16 ReadU16(QByteArray const & data, int pos)
+{
+  uchar const * p = reinterpret_cast<uchar const *>(data.constData()) + pos;
+  return static_cast<quint16>(p[0] | p[1] << 8);
+}
+
+quint32 ReadU32(QByteArray const & data, int pos)
+{
+  return ReadU16(data, pos) | static_cast<quint32>(ReadU16(data, pos + 2)) << 16;
+}
+
+quint64 ReadU64(QByteArray const & data, int pos)
+{
+  return ReadU32(data, pos) | static_cast<quint64>(ReadU32(data, pos + 4)) << 32;
+}
+
+qint64 DosTimeToMSecs(quint16 time, quint16 date)
+{
+  QDateTime const dateTime(QDate(1980 + (date >> 9), (date >> 5) & 15, date & 31),
+                           QTime(time >> 11, (time >> 5) & 63, (time & 31) * 2));
+  return dateTime.isValid() ? dateTime.toMSecsSinceEpoch() : EntryInfo::InvalidTime;
+}
+
+bool ReadAt(QFile & file, qint64 offset, qint64 size, QByteArray & data)
+{
+  if (!file.seek(offset))
+    return false;
+
+  data = file.read(size);
+  return data.size() == size;
+}
+
+/// Only the central directory at the end of the file is read, member data is never touched
+bool ReadZip(QFile & file, IndexBuilder & builder, std::atomic<bool> const & canceled, QString & error)
+{
+  // end of central directory record, a comment of up to 64 KiB and the zip64 locator before it
+  qint64 const fileSize = file.size();
+  qint64 const tailSize = std::min<qint64>(fileSize, 22 + 0xFFFF + 20);
+  QByteArray tail;
+  if (!ReadAt(file, fileSize - tailSize, tailSize, tail))
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  int eocd = tail.size() - 22;
+  while (eocd >= 0 && ReadU32(tail, eocd) != 0x06054b50)
+    --eocd;
+
+  if (eocd < 0)
+  {
+    error = QStringLiteral("Zip end of central directory is not found");
+    return false;
+  }
+
+  quint64 entryCount = ReadU16(tail, eocd + 10);
+  quint64 directorySize = ReadU32(tail, eocd + 12);
+  quint64 directoryOffset = ReadU32(tail, eocd + 16);
+  if ((entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) &&
+      eocd >= 20 && ReadU32(tail, eocd - 20) == 0x07064b50)
+  {
+    QByteArray record;
+    if (!ReadAt(file, static_cast<qint64>(ReadU64(tail, eocd - 20 + 8)), 56, record) ||
+        ReadU32(record, 0) != 0x06064b50)
+    {
+      error = QStringLiteral("Zip64 end of central directory is corrupted");
+      return false;
+    }
+
+    entryCount = ReadU64(record, 32);
+    directorySize = ReadU64(record, 40);
+    directoryOffset = ReadU64(record, 48);
+  }
+
+  QByteArray directory;
+  if (directorySize > INT_MAX || directoryOffset + directorySize > static_cast<quint64>(fileSize) ||
+      !ReadAt(file, static_cast<qint64>(directoryOffset), static_cast<qint64>(directorySize), directory))
+  {
+    error = QStringLiteral("Zip central directory is corrupted");
+    return false;
+  }
+
+  int pos = 0;
+  for (quint64 i = 0; i < entryCount; ++i)
+  {
+    if (canceled == true)
+      return false;
+
+    if (pos + 46 > directory.size() || ReadU32(directory, pos) != 0x02014b50)
+    {
+      error = QStringLiteral("Zip central directory is corrupted");
+      return false;
+    }
+
+    quint16 const madeBy = ReadU16(directory, pos + 4);
+    quint16 const flags = ReadU16(directory, pos + 8);
+    quint64 size = ReadU32(directory, pos + 24);
+    int const nameLength = ReadU16(directory, pos + 28);
+    int const extraLength = ReadU16(directory, pos + 30);
+    int const commentLength = ReadU16(directory, pos + 32);
+    quint32 const externalAttributes = ReadU32(directory, pos + 38);
+    qint64 modifiedTime = DosTimeToMSecs(ReadU16(directory, pos + 12), ReadU16(directory, pos + 14));
+
+    int const next = pos + 46 + nameLength + extraLength + commentLength;
+    if (next > directory.size())
+    {
+      error = QStringLiteral("Zip central directory is corrupted");
+      return false;
+    }
+
+    char const * name = directory.constData() + pos + 46;
+    // bit 11 marks UTF-8 names, older archives use the DOS code page that is ASCII for the common part
+    QString const path = (flags & 0x800) != 0 ? QString::fromUtf8(name, nameLength)
+                                              : QString::fromLatin1(name, nameLength);
+
+    int const extraEnd = pos + 46 + nameLength + extraLength;
+    for (int extra = pos + 46 + nameLength; extra + 4 <= extraEnd;)
+    {
+      quint16 const id = ReadU16(directory, extra);
+      int const length = ReadU16(directory, extra + 2);
+      if (extra + 4 + length > extraEnd)
+        break;
+
+      if (id == 0x0001 && size == 0xFFFFFFFF && length >= 8)
+        size = ReadU64(directory, extra + 4);
+      else if (id == 0x5455 && length >= 5 && (directory[extra + 4] & 1) != 0)
+        modifiedTime = static_cast<qint64>(ReadU32(directory, extra + 5)) * 1000;
+      extra += 4 + length;
+    }
+
+    bool isDir = path.endsWith('/');
+    quint16 permissions = 0;
+    if (madeBy >> 8 == 3)
+    {
+      quint32 const mode = externalAttributes >> 16;
+      isDir = isDir || (mode & 0170000) == 0040000;
+      permissions = UnixToPermissions(mode);
+    }
+    else
+      isDir = isDir || (externalAttributes & 0x10) != 0;
+
+    builder.Add(path, isDir, static_cast<qint64>(size), modifiedTime, permissions);
+    pos = next;
+  }
+
+  return true;
+}
+
+/// Sequential source of tar blocks, plain or decompressed on the fly
+class InputStream
+{
+public:
+  virtual ~InputStream()
+  {
+  }
+
+  /// Fewer bytes only at the end of the stream, -1 on an error
+  virtual qint64 Read(char * data, qint64 size) = 0;
+
+  virtual bool Skip(qint64 size)
+  {
+    char buffer[64 * 1024];
+    while (size > 0)
+    {
+      qint64 const count = Read(buffer, std::min<qint64>(size, sizeof(buffer)));
+      if (count <= 0)
+        return false;
+      size -= count;
+    }
+
+    return true;
+  }
+};
+
+class FileInput : public InputStream
+{
+public:
+  explicit FileInput(QFile & file)
+    : m_file(file)
+  {
+  }
+
+  qint64 Read(char * data, qint64 size) override
+  {
+    qint64 total = 0;
+    while (total < size)
+    {
+      qint64 const count = m_file.read(data + total, size - total);
+      if (count < 0)
+        return -1;
+      if (count == 0)
+        break;
+      total += count;
+    }
+
+    return total;
+  }
+
+  /// Member data of an uncompressed tar is jumped over, only the headers are read
+  bool Skip(qint64 size) override
+  {
+    qint64 const target = m_file.pos() + size;
+    return target <= m_file.size() && m_file.seek(target);
+  }
+
+private:
+  QFile & m_file;
+};
+
+#ifdef LOOKFOR_ZLIB
+class GzipInput : public InputStream
+{
+public:
+  explicit GzipInput(QFile & file)
+    : m_file(file)
+    , m_input(InputBufferSize)
+  {
+    std::memset(&m_stream, 0, sizeof(m_stream));
+    // 32 lets zlib detect the gzip header
+    m_isValid = inflateInit2(&m_stream, 15 + 32) == Z_OK;
+  }
+
+  ~GzipInput()
+  {
+    if (m_isValid)
+      inflateEnd(&m_stream);
+  }
+
+  qint64 Read(char * data, qint64 size) override
+  {
+    if (!m_isValid)
+      return -1;
+
+    m_stream.next_out = reinterpret_cast<Bytef *>(data);
+    m_stream.avail_out = static_cast<uInt>(size);
+    while (m_stream.avail_out > 0)
+    {
+      if (m_stream.avail_in == 0)
+      {
+        qint64 const count = m_file.read(m_input.data(), static_cast<qint64>(m_input.size()));
+        if (count < 0)
+          return -1;
+        if (count == 0)
+          break;
+        m_stream.next_in = reinterpret_cast<Bytef *>(m_input.data());
+        m_stream.avail_in = static_cast<uInt>(count);
+      }
+
+      int const result = inflate(&m_stream, Z_NO_FLUSH);
+      if (result == Z_STREAM_END)
+      {
+        // concatenated members form one stream
+        if (inflateReset(&m_stream) != Z_OK)
+          return -1;
+      }
+      else if (result != Z_OK && result != Z_BUF_ERROR)
+        return -1;
+    }
+
+    return size - m_stream.avail_out;
+  }
+
+private:
+  QFile & m_file;
+  std::vector<char> m_input;
+  z_stream m_stream;
+  bool m_isValid = false;
+};
+#endif
+
+#ifdef LOOKFOR_ZSTD
+class ZstdInput : public InputStream
+{
+public:
+  explicit ZstdInput(QFile & file)
+    : m_file(file)
+    , m_input(InputBufferSize)
+    , m_stream(ZSTD_createDStream())
+  {
+    ZSTD_initDStream(m_stream);
+    m_inBuffer.src = m_input.data();
+    m_inBuffer.size = 0;
+    m_inBuffer.pos = 0;
+  }
+
+  ~ZstdInput()
+  {
+    ZSTD_freeDStream(m_stream);
+  }
+
+  qint64 Read(char * data, qint64 size) override
+  {
+    ZSTD_outBuffer output = { data, static_cast<size_t>(size), 0 };
+    while (output.pos < output.size)
+    {
+      if (m_inBuffer.pos == m_inBuffer.size)
+      {
+        qint64 const count = m_file.read(m_input.data(), static_cast<qint64>(m_input.size()));
+        if (count < 0)
+          return -1;
+        if (count == 0)
+          break;
+        m_inBuffer.size = static_cast<size_t>(count);
+        m_inBuffer.pos = 0;
+      }
+
+      if (ZSTD_isError(ZSTD_decompressStream(m_stream, &output, &m_inBuffer)))
+        return -1;
+    }
+
+    return static_cast<qint64>(output.pos);
+  }
+
+private:
+  QFile & m_file;
+  std::vector<char> m_input;
+  ZSTD_DStream * m_stream;
+  ZSTD_inBuffer m_inBuffer;
+};
+#endif
+
+/// Octal text or the base-256 form GNU tar uses for big values
+qint64 ParseTarNumber(char const * field, int length)
+{
+  uchar const * p = reinterpret_cast<uchar const *>(field);
+  qint64 value = 0;
+  if ((p[0] & 0x80) != 0)
+  {
+    value = p[0] & 0x7F;
+    for (int i = 1; i < length; ++i)
+      value = value << 8 | p[i];
+    return value;
+  }
+
+  int i = 0;
+  while (i < length && p[i] == ' ')
+    ++i;
+  for (; i < length && p[i] >= '0' && p[i] <= '7'; ++i)
+    value = value * 8 + (p[i] - '0');
+
+  return value;
+}
+
+QString ParseTarString(char const * field, int length)
+{
+  return QString::fromUtf8(field, static_cast<int>(std::find(field, field + length, '\0') - field));
+}
+
+bool IsValidTarHeader(char const * header)
+{
+  // the checksum field itself counts as spaces, old tars summed signed bytes
+  qint64 unsignedSum = 8 * ' ';
+  qint64 signedSum = 8 * ' ';
+  for (int i = 0; i < TarBlockSize; ++i)
+  {
+    if (i >= 148 && i < 156)
+      continue;
+    unsignedSum += static_cast<uchar>(header[i]);
+    signedSum += static_cast<signed char>(header[i]);
+  }
+
+  qint64 const checksum = ParseTarNumber(header + 148, 8);
+  return checksum == unsignedSum || checksum == signedSum;
+}
+
+/// Overrides of the next member from a pax extended header
+struct PaxHeader
+{
+  QString m_path;
+  qint64 m_size = -1;
+  qint64 m_modifiedTime = EntryInfo::InvalidTime;
+};
+
+void ParsePaxHeader(QByteArray const & data, PaxHeader & pax)
+{
+  // records are "<length> <key>=<value>\n", the length includes itself
+  int pos = 0;
+  while (pos < data.size())
+  {
+    int const space = data.indexOf(' ', pos);
+    if (space < 0)
+      return;
+
+    int const length = data.mid(pos, space - pos).toInt();
+    if (length <= space - pos + 1 || pos + length > data.size())
+      return;
+
+    QByteArray const record = data.mid(space + 1, pos + length - space - 2);
+    int const equal = record.indexOf('=');
+    if (equal > 0)
+    {
+      QByteArray const key = record.left(equal);
+      QByteArray const value = record.mid(equal + 1);
+      if (key == "path")
+        pax.m_path = QString::fromUtf8(value);
+      else if (key == "size")
+        pax.m_size = value.toLongLong();
+      else if (key == "mtime")
+        pax.m_modifiedTime = static_cast<qint64>(value.toDouble() * 1000);
+    }
+
+    pos += length;
+  }
+}
+
+qint64 PadToBlock(qint64 size)
+{
+  return (size + TarBlockSize - 1) / TarBlockSize * TarBlockSize;
+}
+
+/// Reads headers one by one, member data is skipped as it streams by
+bool ReadTar(InputStream & input, IndexBuilder & builder, std::atomic<bool> const & canceled, QString & error)
+{
+  char header[TarBlockSize];
+  QByteArray longName;
+  PaxHeader pax;
+  bool isFirst = true;
+  while (canceled == false)
+  {
+    qint64 const count = input.Read(header, TarBlockSize);
+    if (count == 0 && !isFirst)
+      return true;
+
+    if (count != TarBlockSize)
+    {
+      error = count < 0 ? QStringLiteral("Archive read error") : QStringLiteral("Archive is truncated");
+      return false;
+    }
+
+    // two zero blocks end the archive, one is enough to stop
+    if (std::all_of(header, header + TarBlockSize, [](char c) { return c == 0; }))
+      return true;
+
+    if (!IsValidTarHeader(header))
+    {
+      error = isFirst ? QStringLiteral("Not a supported archive") : QStringLiteral("Tar header is corrupted");
+      return false;
+    }
+
+    isFirst = false;
+    qint64 const size = ParseTarNumber(header + 124, 12);
+    char const type = header[156];
+    if (type == 'L' || type == 'x')
+    {
+      if (size > MaxTarMetadataSize)
+      {
+        error = QStringLiteral("Tar header is corrupted");
+        return false;
+      }
+
+      QByteArray data(static_cast<int>(PadToBlock(size)), '\0');
+      if (input.Read(data.data(), data.size()) != data.size())
+      {
+        error = QStringLiteral("Archive is truncated");
+        return false;
+      }
+
+      data.truncate(static_cast<int>(size));
+      int const end = data.indexOf('\0');
+      if (type == 'L')
+        longName = end < 0 ? data : data.left(end);
+      else
+        ParsePaxHeader(data, pax);
+      continue;
+    }
+
+    // long link names and global pax headers do not describe a member
+    if (type == 'K' || type == 'g')
+    {
+      if (!input.Skip(PadToBlock(size)))
+      {
+        error = QStringLiteral("Archive is truncated");
+        return false;
+      }
+      continue;
+    }
+
+    QString path;
+    if (!pax.m_path.isEmpty())
+      path = pax.m_path;
+    else if (!longName.isEmpty())
+      path = QString::fromUtf8(longName);
+    else
+    {
+      path = ParseTarString(header, 100);
+      if (std::memcmp(header + 257, "ustar\0", 6) == 0 && header[345] != '\0')
+        path = ParseTarString(header + 345, 155) + '/' + path;
+    }
+
+    qint64 const dataSize = pax.m_size >= 0 ? pax.m_size : size;
+    qint64 const modifiedTime = pax.m_modifiedTime != EntryInfo::InvalidTime
+                                ? pax.m_modifiedTime : ParseTarNumber(header + 136, 12) * 1000;
+    bool const isDir = type == '5' || ((type == '0' || type == '\0') && path.endsWith('/'));
+    builder.Add(path, isDir, dataSize, modifiedTime, UnixToPermissions(static_cast<quint32>(ParseTarNumber(header + 100, 8))));
+
+    longName.clear();
+    pax = PaxHeader();
+    if (!input.Skip(PadToBlock(dataSize)))
+    {
+      error = QStringLiteral("Archive is truncated");
+      return false;
+    }
+  }
+
+  return false;
+}
+
+struct CacheKey
+{
+  quint64 m_device;
+  quint64 m_inode;
+  qint64 m_size;
+  qint64 m_modifiedTime;
+
+  bool operator == (CacheKey const & other) const
+  {
+    return m_device == other.m_device && m_inode == other.m_inode &&
+           m_size == other.m_size && m_modifiedTime == other.m_modifiedTime;
+  }
+};
+
+/// Recently read indices, the first one is the most recently used
+class IndexCache
+{
+public:
+  std::shared_ptr<ArchiveIndex const> Find(CacheKey const & key)
+  {
+    QMutexLocker lock(&m_mutex);
+    for (size_t i = 0; i < m_items.size(); ++i)
+    {
+      if (m_items[i].first == key)
+      {
+        std::rotate(m_items.begin(), m_items.begin() + i, m_items.begin() + i + 1);
+        return m_items.front().second;
+      }
+    }
+
+    return nullptr;
+  }
+
+  void Insert(CacheKey const & key, std::shared_ptr<ArchiveIndex const> const & index)
+  {
+    QMutexLocker lock(&m_mutex);
+    m_items.insert(m_items.begin(), std::make_pair(key, index));
+    m_entryCount += index->m_entries.size();
+
+    // the newest index stays even when it alone is over the limit
+    while (m_items.size() > 1 && m_entryCount > MaxCachedEntries)
+    {
+      m_entryCount -= m_items.back().second->m_entries.size();
+      m_items.pop_back();
+    }
+  }
+
+private:
+  QMutex m_mutex;
+  std::vector<std::pair<CacheKey, std::shared_ptr<ArchiveIndex const> > > m_items;
+  size_t m_entryCount = 0;
+};
+
+IndexCache & GetIndexCache()
+{
+  static IndexCache cache;
+  return cache;
+}
+
+std::unique_ptr<InputStream> OpenTarInput(QFile & file, QByteArray const & magic, QString & error)
+{
+  if (magic.startsWith("\x1F\x8B"))
+  {
+#ifdef LOOKFOR_ZLIB
+    return std::unique_ptr<InputStream>(new GzipInput(file));
+#else
+    error = QStringLiteral("Gzip support is not built in");
+    return nullptr;
+#endif
+  }
+
+  if (magic.startsWith("\x28\xB5\x2F\xFD"))
+  {
+#ifdef LOOKFOR_ZSTD
+    return std::unique_ptr<InputStream>(new ZstdInput(file));
+#else
+    error = QStringLiteral("Zstandard support is not built in");
+    return nullptr;
+#endif
+  }
+
+  return std::unique_ptr<InputStream>(new FileInput(file));
+}
+
+} // namespace
+
+ArchiveEntry const * ArchiveIndex::FindDir(QString const & innerPath) const
+{
+  QHash<QString, quint32>::const_iterator it = m_dirs.constFind(innerPath);
+  if (it == m_dirs.constEnd())
+    return nullptr;
+
+  return &m_entries[it.value()];
+}
+
+bool IsArchiveName(QString const & name)
+{
+  static char const * const suffixes[] =
+  {
+    ".zip", ".jar", ".war", ".apk", ".tar",
+#ifdef LOOKFOR_ZLIB
+    ".tar.gz", ".tgz",
+#endif
+#ifdef LOOKFOR_ZSTD
+    ".tar.zst", ".tzst",
+#endif
+  };
+
+  for (char const * suffix : suffixes)
+  {
+    if (name.endsWith(QLatin1String(suffix), Qt::CaseInsensitive))
+      return true;
+  }
+
+  return false;
+}
+
+std::shared_ptr<ArchiveIndex const> ReadArchiveIndex(QString const & path, std::atomic<bool> const & canceled,
+                                                     QString & error)
+{
+  FileStat stat;
+  if (!ReadFileStat(path, stat))
+  {
+    error = QStringLiteral("Cannot read %1").arg(path);
+    return nullptr;
+  }
+
+  CacheKey const key = { stat.m_device, stat.m_inode, stat.m_size, stat.m_modifiedTime };
+  std::shared_ptr<ArchiveIndex const> cached = GetIndexCache().Find(key);
+  if (cached != nullptr)
+    return cached;
+
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    error = file.errorString();
+    return nullptr;
+  }
+
+  std::shared_ptr<ArchiveIndex> index = std::make_shared<ArchiveIndex>();
+  IndexBuilder builder(*index);
+  QByteArray const magic = file.peek(4);
+  if (magic.startsWith("PK\x03\x04") || magic.startsWith("PK\x05\x06"))
+  {
+    if (!ReadZip(file, builder, canceled, error))
+      return nullptr;
+  }
+  else
+  {
+    std::unique_ptr<InputStream> input = OpenTarInput(file, magic, error);
+    if (input == nullptr || !ReadTar(*input, builder, canceled, error))
+      return nullptr;
+  }
+
+  GetIndexCache().Insert(key, index);
+  return index;
+}
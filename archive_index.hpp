@@ -0,0 +1,47 @@
+#pragma once
+
+#include "entry_info.hpp"
+
+#include <QHash>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// File or directory inside an archive
+struct ArchiveEntry
+{
+  QString m_name;
+  qint64 m_size = 0;
+  /// milliseconds since epoch, EntryInfo::InvalidTime for directories that have no own header
+  qint64 m_modifiedTime = EntryInfo::InvalidTime;
+  /// QFile::Permissions bits
+  quint16 m_permissions = 0;
+  bool m_isDir = false;
+  /// positions in ArchiveIndex::m_entries
+  std::vector<quint32> m_children;
+};
+
+/// Tree of archive members built from the zip central directory or the tar headers,
+/// directories that appear only in member paths are added as well
+struct ArchiveIndex
+{
+  /// the top level directory is always at position 0
+  std::vector<ArchiveEntry> m_entries;
+  /// inner path of every directory without a trailing slash, "" for the top level
+  QHash<QString, quint32> m_dirs;
+
+  /// nullptr when there is no such directory
+  ArchiveEntry const * FindDir(QString const & innerPath) const;
+};
+
+/// Zip and tar archives, compressed tars when the decompressor is built in.
+/// Decided by name only, so a scan never opens files to find archives.
+bool IsArchiveName(QString const & name);
+
+/// Reads only the zip central directory or streams the tar headers, nothing is extracted.
+/// Indices are cached by device, inode, size and modification time, so reopening an unchanged
+/// archive does not touch the file again.
+std::shared_ptr<ArchiveIndex const> ReadArchiveIndex(QString const & path, std::atomic<bool> const & canceled,
+                                                     QString & error);
@@ -0,0 +1,68 @@
+#include "archive_scaner.hpp"
+#include "archive_index.hpp"
+
+namespace
+{
+
+size_t const BatchSize = 256;
+
+} // namespace
+
+ArchiveScaner::ArchiveScaner(QString const & archivePath, QString const & innerPath,
+                             std::shared_ptr<NamePool> const & pool)
+  : DirScaner(archivePath, QString(), pool, nullptr, false)
+  , m_innerPath(innerPath)
+{
+}
+
+void ArchiveScaner::run()
+{
+  // virtual directories have no stamps of their own, an empty stat keeps them out of refresh
+  if (m_canceled == true)
+  {
+    reportMeasured();
+    emit scanFinished(FileStat(), PruneCount(), this);
+    return;
+  }
+
+  // an unreadable archive is left without children, the model shows why
+  QString error;
+  std::shared_ptr<ArchiveIndex const> index = ReadArchiveIndex(m_path, m_canceled, error);
+  if (index == nullptr && m_canceled == false)
+    emit scanFailed(error, this);
+
+  ArchiveEntry const * dir = index != nullptr ? index->FindDir(m_innerPath) : nullptr;
+  if (dir != nullptr)
+  {
+    EntryBatch batch;
+    for (quint32 childIndex : dir->m_children)
+    {
+      if (m_canceled == true)
+        break;
+
+      ArchiveEntry const & child = index->m_entries[childIndex];
+      EntryInfo entry;
+      if (!m_pool->Intern(child.m_name, entry.m_name))
+        continue;
+
+      entry.m_permissions = child.m_permissions;
+      entry.m_flags = static_cast<quint8>(EntryInfo::Virtual | (child.m_isDir ? EntryInfo::Dir : 0));
+      entry.m_size = child.m_size;
+      entry.m_modifiedTime = child.m_modifiedTime;
+      batch.m_entries.push_back(entry);
+      ++m_processedCount;
+
+      if (batch.m_entries.size() >= BatchSize)
+      {
+        emit entriesFounded(batch, this);
+        batch.m_entries.clear();
+      }
+    }
+
+    if (!batch.m_entries.empty() && m_canceled == false)
+      emit entriesFounded(batch, this);
+  }
+
+  reportMeasured();
+  emit scanFinished(FileStat(), PruneCount(), this);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "dir_scaner.hpp"
+
+/// Lists one directory inside an archive through the DirScaner signals, so the model
+/// fills virtual nodes the same way it fills real ones
+class ArchiveScaner : public DirScaner
+{
+  Q_OBJECT
+
+public:
+  /// innerPath is the directory inside the archive, "" for its top level
+  ArchiveScaner(QString const & archivePath, QString const & innerPath, std::shared_ptr<NamePool> const & pool);
+
+protected:
+  void run() override;
+
+private:
+  QString m_innerPath;
+};
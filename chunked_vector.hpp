@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/// Sequence stored in fixed size chunks. Growing never moves stored elements and
+/// never needs one huge contiguous block, which matters for directories with millions of entries.
+template <typename T, size_t ChunkSize = 1024>
+class ChunkedVector
+{
+public:
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+
+  T & operator[](size_t index)
+  {
+    Q_ASSERT(index < m_size);
+    return m_chunks[index / ChunkSize][index % ChunkSize];
+  }
+
+  T const & operator[](size_t index) const
+  {
+    Q_ASSERT(index < m_size);
+    return m_chunks[index / ChunkSize][index % ChunkSize];
+  }
+
+  T & back()
+  {
+    Q_ASSERT(m_size > 0);
+    return m_chunks.back().back();
+  }
+
+  T const & back() const
+  {
+    Q_ASSERT(m_size > 0);
+    return m_chunks.back().back();
+  }
+
+  void push_back(T && value)
+  {
+    if (m_size % ChunkSize == 0)
+    {
+      m_chunks.emplace_back();
+      m_chunks.back().reserve(ChunkSize);
+    }
+
+    m_chunks.back().push_back(std::move(value));
+    ++m_size;
+  }
+
+  void pop_back()
+  {
+    Q_ASSERT(m_size > 0);
+    m_chunks.back().pop_back();
+    if (m_chunks.back().empty())
+      m_chunks.pop_back();
+    --m_size;
+  }
+
+  /// Removes [first, last) range, elements after it are shifted down
+  void erase(size_t first, size_t last)
+  {
+    Q_ASSERT(first <= last && last <= m_size);
+    for (size_t i = last; i < m_size; ++i)
+      (*this)[first + i - last] = std::move((*this)[i]);
+
+    for (size_t i = first; i < last; ++i)
+      pop_back();
+  }
+
+  void clear()
+  {
+    m_chunks.clear();
+    m_size = 0;
+  }
+
+private:
+  std::vector<std::vector<T> > m_chunks;
+  size_t m_size = 0;
+};
@@ -0,0 +1,175 @@
+#include "diff_model.hpp"
+#include "snapshot_diff.hpp"
+
+#include <QBrush>
+#include <QIcon>
+
+namespace
+{
+
+enum EColumn
+{
+  NameColumn,
+  ChangeColumn,
+  AddedColumn,
+  RemovedColumn,
+  ModifiedColumn,
+  SizeChangeColumn,
+  ColumnCount
+};
+
+QString GetChangeName(DiffNode const * node)
+{
+  switch (node->m_change)
+  {
+  case DiffNode::Added:
+    return QStringLiteral("Added");
+  case DiffNode::Removed:
+    return QStringLiteral("Removed");
+  case DiffNode::Modified:
+    return node->m_newSize > node->m_oldSize ? QStringLiteral("Grown")
+                                             : (node->m_newSize < node->m_oldSize ? QStringLiteral("Shrunk")
+                                                                                  : QStringLiteral("Modified"));
+  case DiffNode::Unchanged:
+    break;
+  }
+
+  return QString();
+}
+
+} // namespace
+
+DiffModel::DiffModel(QObject * parent)
+  : TBase(parent)
+{
+}
+
+DiffModel::~DiffModel()
+{
+}
+
+void DiffModel::setDiff(std::unique_ptr<DiffNode> && root)
+{
+  beginResetModel();
+  m_root = std::move(root);
+  endResetModel();
+}
+
+int DiffModel::rowCount(QModelIndex const & parent) const
+{
+  if (!parent.isValid())
+    return m_root ? 1 : 0;
+
+  if (parent.column() != 0)
+    return 0;
+
+  Q_ASSERT(parent.internalPointer() != nullptr);
+  DiffNode * node = static_cast<DiffNode *>(parent.internalPointer());
+  return static_cast<int>(node->m_children.size());
+}
+
+int DiffModel::columnCount(QModelIndex const & /*parent*/) const
+{
+  return ColumnCount;
+}
+
+QModelIndex DiffModel::index(int row, int column, QModelIndex const & parent) const
+{
+  DiffNode * node = static_cast<DiffNode *>(parent.internalPointer());
+  if (node == nullptr)
+    return createIndex(row, column, m_root.get());
+
+  Q_ASSERT(row < static_cast<int>(node->m_children.size()));
+  return createIndex(row, column, node->m_children[row].get());
+}
+
+QModelIndex DiffModel::parent(QModelIndex const & child) const
+{
+  DiffNode * childNode = static_cast<DiffNode *>(child.internalPointer());
+  if (childNode == nullptr)
+    return QModelIndex();
+
+  DiffNode * parent = childNode->m_parent;
+  if (parent == nullptr)
+    return QModelIndex();
+
+  return createIndex(parent->m_row, 0, parent);
+}
+
+QVariant DiffModel::data(QModelIndex const & index, int role) const
+{
+  Q_ASSERT(index.internalPointer() != nullptr);
+  DiffNode * node = static_cast<DiffNode *>(index.internalPointer());
+  DiffTotals const & totals = node->m_totals;
+
+  if (role == Qt::DisplayRole)
+  {
+    switch (index.column())
+    {
+    case NameColumn:
+      return node->m_name;
+    case ChangeColumn:
+      return GetChangeName(node);
+    case AddedColumn:
+      return totals.m_added;
+    case RemovedColumn:
+      return totals.m_removed;
+    case ModifiedColumn:
+      return totals.m_modified;
+    case SizeChangeColumn:
+      return totals.m_grown - totals.m_shrunk;
+    }
+  }
+  else if (role == Qt::ForegroundRole && index.column() == ChangeColumn)
+  {
+    if (node->m_change == DiffNode::Added)
+      return QBrush(Qt::darkGreen);
+    if (node->m_change == DiffNode::Removed)
+      return QBrush(Qt::red);
+  }
+  else if (role == Qt::DecorationRole && index.column() == NameColumn)
+  {
+    static QIcon rootIcon(QStringLiteral(":/assets/root.png"));
+    static QIcon folderIcon(QStringLiteral(":/assets/folder.png"));
+    static QIcon fileIcon(QStringLiteral(":/assets/file.png"));
+
+    if (node->m_parent == nullptr)
+      return rootIcon;
+    return node->m_isDir ? folderIcon : fileIcon;
+  }
+  else if (role == Qt::ToolTipRole && index.column() == SizeChangeColumn)
+  {
+    return QStringLiteral("+%1 / -%2 bytes").arg(totals.m_grown).arg(totals.m_shrunk);
+  }
+
+  return QVariant();
+}
+
+QVariant DiffModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation == Qt::Vertical || role != Qt::DisplayRole)
+    return QVariant();
+
+  switch (section)
+  {
+  case NameColumn:
+    return QStringLiteral("Name");
+  case ChangeColumn:
+    return QStringLiteral("Change");
+  case AddedColumn:
+    return QStringLiteral("Added");
+  case RemovedColumn:
+    return QStringLiteral("Removed");
+  case ModifiedColumn:
+    return QStringLiteral("Modified");
+  case SizeChangeColumn:
+    return QStringLiteral("Size change");
+  }
+
+  return QVariant();
+}
+
+Qt::ItemFlags DiffModel::flags(QModelIndex const & /*index*/) const
+{
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QAbstractItemModel>
+#include <memory>
+
+struct DiffNode;
+
+/// Result of a snapshot comparison. Directories show the totals of everything changed below them,
+/// added and removed directories are single rows.
+class DiffModel : public QAbstractItemModel
+{
+  using TBase = QAbstractItemModel;
+public:
+  DiffModel(QObject * parent = 0);
+  ~DiffModel();
+
+  /// Takes ownership of the tree
+  void setDiff(std::unique_ptr<DiffNode> && root);
+
+  int rowCount(QModelIndex const & parent) const override;
+  int columnCount(QModelIndex const & parent) const override;
+
+  QModelIndex index(int row, int column, QModelIndex const & parent) const override;
+  QModelIndex parent(QModelIndex const & child) const override;
+  QVariant data(QModelIndex const & index, int role) const override;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+  Qt::ItemFlags flags(QModelIndex const & index) const override;
+
+private:
+  std::unique_ptr<DiffNode> m_root;
+};
@@ -1,15 +1,55 @@
 #include "dir_scaner.hpp"
 
 #include <QDirIterator>
+#include <QElapsedTimer>
 
-DirScaner::DirScaner(QString const & path)
+namespace
+{
+
+size_t const BatchSize = 256;
+qint64 const BatchTimeout = 50;
+
+} // namespace
+
+DirScaner::DirScaner(QString const & path, QString const & relativePath, std::shared_ptr<NamePool> const & pool,
+                     TIgnoreRules const & rules, bool readGitIgnore)
   : m_path(path)
+  , m_pool(pool)
   , m_canceled(false)
+  , m_processedCount(0)
+  , m_relativePath(relativePath)
+  , m_rules(rules)
+  , m_readGitIgnore(readGitIgnore)
 {
 }
 
 void DirScaner::run()
 {
+  // canceled while waiting in the scheduler queue
+  if (m_canceled == true)
+  {
+    reportMeasured();
+    emit scanFinished(FileStat(), PruneCount(), this);
+    return;
+  }
+
+  FileStat dirStat;
+  ReadFileStat(m_path, dirStat);
+
+  TIgnoreRules rules = m_rules;
+  if (m_readGitIgnore)
+  {
+    rules = ReadGitIgnore(m_rules, m_path, m_relativePath);
+    if (rules != m_rules)
+      emit rulesFounded(rules, this);
+  }
+
+  PruneCount pruned;
+
+  EntryBatch batch;
+  QElapsedTimer timer;
+  timer.start();
+
   QDirIterator iter(m_path);
   while (iter.hasNext())
   {
@@ -17,10 +57,39 @@ void DirScaner::run()
       break;
 
     iter.next();
-    emit fileFounded(iter.fileInfo(), this);
+    QString fileName = iter.fileName();
+    if (fileName == "." || fileName == "..")
+      continue;
+
+    ++m_processedCount;
+    // an excluded directory is never queued, so nothing below it is read
+    QFileInfo const info = iter.fileInfo();
+    if (rules != nullptr && rules->IsExcluded(m_relativePath, fileName, info.isDir()))
+    {
+      ++(info.isDir() ? pruned.m_dirs : pruned.m_files);
+      continue;
+    }
+
+    // a full pool is counted by the pool itself and shown in the scan diagnostics
+    EntryInfo entry;
+    if (!MakeEntryInfo(info, fileName, *m_pool, entry))
+      continue;
+
+    batch.m_entries.push_back(entry);
+
+    if (batch.m_entries.size() >= BatchSize || timer.elapsed() > BatchTimeout)
+    {
+      emit entriesFounded(batch, this);
+      batch.m_entries.clear();
+      timer.restart();
+    }
   }
 
-  emit scanFinished(this);
+  if (!batch.m_entries.empty() && m_canceled == false)
+    emit entriesFounded(batch, this);
+
+  reportMeasured();
+  emit scanFinished(dirStat, pruned, this);
 }
 
 void DirScaner::cancel()
@@ -28,3 +97,13 @@ void DirScaner::cancel()
   m_canceled = true;
 }
 
+quint64 DirScaner::processedCount() const
+{
+  return m_processedCount;
+}
+
+bool DirScaner::isCanceled() const
+{
+  return m_canceled;
+}
+
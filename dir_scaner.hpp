@@ -1,27 +1,49 @@
 #pragma once
 
+#include "entry_info.hpp"
+#include "file_stat.hpp"
+#include "ignore_rules.hpp"
+#include "scan_scheduler.hpp"
+
 #include <QObject>
 #include <QRunnable>
 #include <atomic>
+#include <memory>
 
-class QFileInfo;
-
-class DirScaner : public QObject, public QRunnable
+class DirScaner : public QObject, public ScanTask
 {
   Q_OBJECT
 
 public:
-  DirScaner(QString const & path);
-
-  Q_SIGNAL void fileFounded(QFileInfo const & info, DirScaner * scaner);
-  Q_SIGNAL void scanFinished(DirScaner * scaner);
+  /// relativePath is the path below the scanned root the rules are matched against.
+  /// With readGitIgnore a .gitignore file of the directory is added to rules.
+  DirScaner(QString const & path, QString const & relativePath, std::shared_ptr<NamePool> const & pool,
+            TIgnoreRules const & rules, bool readGitIgnore);
+
+  /// Rules of the .gitignore file in the directory, sent before any entry
+  Q_SIGNAL void rulesFounded(TIgnoreRules const & rules, DirScaner * scaner);
+  /// Names are interned on the pool thread, the model receives only references
+  Q_SIGNAL void entriesFounded(EntryBatch const & batch, DirScaner * scaner);
+  /// The directory could not be read, sent before scanFinished
+  Q_SIGNAL void scanFailed(QString const & error, DirScaner * scaner);
+  /// dirStat is read before the listing starts, so later changes are seen by a refresh
+  Q_SIGNAL void scanFinished(FileStat const & dirStat, PruneCount const & pruned, DirScaner * scaner);
 
   void cancel();
 
+  quint64 processedCount() const override;
+  bool isCanceled() const override;
+
 protected:
   void run();
 
-private:
   QString m_path;
+  std::shared_ptr<NamePool> m_pool;
   std::atomic<bool> m_canceled;
+  std::atomic<quint64> m_processedCount;
+
+private:
+  QString m_relativePath;
+  TIgnoreRules m_rules;
+  bool m_readGitIgnore;
 };
@@ -0,0 +1,118 @@
+#include "entry_info.hpp"
+#include "archive_index.hpp"
+#include "file_stat.hpp"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QReadWriteLock>
+
+#ifndef Q_OS_WIN
+  #include <cerrno>
+  #include <pwd.h>
+  #include <vector>
+#endif
+
+qint64 const EntryInfo::InvalidTime;
+
+namespace
+{
+
+qint64 ToMSecs(QDateTime const & time)
+{
+  return time.isValid() ? time.toMSecsSinceEpoch() : EntryInfo::InvalidTime;
+}
+
+QReadWriteLock s_ownersLock;
+QHash<uint, QString> s_owners;
+
+/// resolveOwner is only called for ids not seen before
+template <typename TResolve>
+void RegisterOwner(uint ownerId, TResolve const & resolveOwner)
+{
+  {
+    QReadLocker lock(&s_ownersLock);
+    if (s_owners.contains(ownerId))
+      return;
+  }
+
+  QString const owner = resolveOwner();
+  QWriteLocker lock(&s_ownersLock);
+  s_owners.insert(ownerId, owner);
+}
+
+#ifndef Q_OS_WIN
+QString ReadOwnerName(uint ownerId)
+{
+  size_t const MaxBufferSize = 1024 * 1024;
+  std::vector<char> buffer(1024);
+  passwd entry;
+  passwd * result = nullptr;
+  while (::getpwuid_r(ownerId, &entry, buffer.data(), buffer.size(), &result) == ERANGE &&
+         buffer.size() < MaxBufferSize)
+    buffer.resize(buffer.size() * 2);
+  return result != nullptr ? QFile::decodeName(result->pw_name) : QString();
+}
+#endif
+
+} // namespace
+
+QString GetOwnerName(uint ownerId)
+{
+  QReadLocker lock(&s_ownersLock);
+  return s_owners.value(ownerId);
+}
+
+bool MakeEntryInfo(QFileInfo const & info, QString const & name, NamePool & pool, EntryInfo & entry)
+{
+  NameRef ref;
+  if (!pool.Intern(name, ref))
+    return false;
+
+  entry = MakeEntryInfo(info);
+  entry.m_name = ref;
+  if (!entry.IsDir() && IsArchiveName(name))
+    entry.m_flags |= EntryInfo::Archive;
+  return true;
+}
+
+EntryInfo MakeEntryInfo(QFileInfo const & info)
+{
+  EntryInfo entry;
+  entry.m_permissions = static_cast<quint16>(info.permissions());
+  entry.m_ownerId = info.ownerId();
+  RegisterOwner(entry.m_ownerId, [&info]() { return info.owner(); });
+  entry.m_size = info.size();
+  entry.m_createdTime = ToMSecs(info.created());
+  entry.m_modifiedTime = ToMSecs(info.lastModified());
+
+  if (info.isDir())
+    entry.m_flags |= EntryInfo::Dir;
+  if (info.isSymLink())
+    entry.m_flags |= EntryInfo::SymLink;
+  if (info.isRoot())
+    entry.m_flags |= EntryInfo::Root;
+
+  return entry;
+}
+
+EntryInfo MakeEntryInfo(FileStat const & stat, bool isSymLink)
+{
+  EntryInfo entry;
+  entry.m_permissions = stat.m_permissions;
+  entry.m_ownerId = stat.m_ownerId;
+#ifndef Q_OS_WIN
+  RegisterOwner(entry.m_ownerId, [&stat]() { return ReadOwnerName(stat.m_ownerId); });
+#endif
+  entry.m_size = stat.m_size;
+  entry.m_createdTime = stat.m_createdTime / 1000000;
+  entry.m_modifiedTime = stat.m_modifiedTime / 1000000;
+
+  if (stat.m_isDir)
+    entry.m_flags |= EntryInfo::Dir;
+  if (isSymLink)
+    entry.m_flags |= EntryInfo::SymLink;
+
+  return entry;
+}
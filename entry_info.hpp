@@ -0,0 +1,82 @@
+#pragma once
+
+#include "name_pool.hpp"
+
+#include <QMetaType>
+
+#include <limits>
+#include <vector>
+
+class QFileInfo;
+struct FileStat;
+
+/// Metadata of a file system entry as the model keeps it, the name lives in NamePool
+struct EntryInfo
+{
+  enum EFlags
+  {
+    Dir = 1,
+    SymLink = 2,
+    Root = 4,
+    /// file whose content can be listed like a directory
+    Archive = 8,
+    /// member of an archive, it has no path of its own on disk
+    Virtual = 16
+  };
+
+  static qint64 const InvalidTime = std::numeric_limits<qint64>::min();
+
+  NameRef m_name;
+  quint16 m_permissions = 0;
+  quint8 m_flags = 0;
+  uint m_ownerId = 0;
+  qint64 m_size = 0;
+  /// milliseconds since epoch
+  qint64 m_createdTime = InvalidTime;
+  qint64 m_modifiedTime = InvalidTime;
+
+  bool IsDir() const
+  {
+    return (m_flags & Dir) != 0;
+  }
+
+  bool IsRoot() const
+  {
+    return (m_flags & Root) != 0;
+  }
+
+  bool IsArchive() const
+  {
+    return (m_flags & Archive) != 0;
+  }
+
+  bool IsVirtual() const
+  {
+    return (m_flags & Virtual) != 0;
+  }
+
+  /// Directories and archives, both are expanded by a scaner
+  bool IsContainer() const
+  {
+    return (m_flags & (Dir | Archive)) != 0;
+  }
+};
+
+/// Interns the name and reads the metadata, stats the entry when QFileInfo has no cached data.
+/// False when the pool is full, the entry is left out then.
+bool MakeEntryInfo(QFileInfo const & info, QString const & name, NamePool & pool, EntryInfo & entry);
+/// Metadata only, for entries that never reach the model
+EntryInfo MakeEntryInfo(QFileInfo const & info);
+/// Metadata from a stat that was already made, owner names are not resolved without Unix
+EntryInfo MakeEntryInfo(FileStat const & stat, bool isSymLink);
+
+/// Owner names are resolved once per id while entries are made, any thread may read them
+QString GetOwnerName(uint ownerId);
+
+/// Entries are handed from scanners to the model in batches
+struct EntryBatch
+{
+  std::vector<EntryInfo> m_entries;
+};
+
+Q_DECLARE_METATYPE(EntryBatch)
@@ -0,0 +1,509 @@
+#include "exporter.hpp"
+#include "file_stat.hpp"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+
+size_t const BufferSize = 1 << 16;
+qint64 const ProgressTimeout = 100;
+
+enum EEscape
+{
+  NoEscape,
+  TsvEscape,
+  JsonEscape
+};
+
+/// Entries are encoded straight into a fixed buffer, nothing is allocated per entry
+class BufferedWriter
+{
+public:
+  BufferedWriter(QFile & file)
+    : m_file(file)
+    , m_buffer(BufferSize)
+  {
+  }
+
+  bool Flush()
+  {
+    if (m_used > 0 && m_file.write(m_buffer.data(), m_used) != static_cast<qint64>(m_used))
+      m_isFailed = true;
+
+    m_used = 0;
+    return !m_isFailed;
+  }
+
+  bool IsFailed() const
+  {
+    return m_isFailed;
+  }
+
+  void Put(char c)
+  {
+    if (m_used == m_buffer.size())
+      Flush();
+    m_buffer[m_used++] = c;
+  }
+
+  void Put(char const * str)
+  {
+    for (; *str != 0; ++str)
+      Put(*str);
+  }
+
+  void PutNumber(qint64 value)
+  {
+    char digits[20];
+    int count = 0;
+    quint64 rest = value < 0 ? 0 - static_cast<quint64>(value) : static_cast<quint64>(value);
+    do
+    {
+      digits[count++] = static_cast<char>('0' + rest % 10);
+      rest /= 10;
+    } while (rest != 0);
+
+    if (value < 0)
+      Put('-');
+    while (count > 0)
+      Put(digits[--count]);
+  }
+
+  void PutHex(uint value)
+  {
+    char const * const hexDigits = "0123456789abcdef";
+    char digits[8];
+    int count = 0;
+    do
+    {
+      digits[count++] = hexDigits[value & 0xF];
+      value >>= 4;
+    } while (value != 0);
+
+    while (count > 0)
+      Put(digits[--count]);
+  }
+
+  /// ISO 8601 in UTC
+  void PutTime(qint64 msecs)
+  {
+    qint64 seconds = msecs / 1000 - (msecs % 1000 < 0 ? 1 : 0);
+    qint64 days = seconds / 86400;
+    qint64 daySeconds = seconds % 86400;
+    if (daySeconds < 0)
+    {
+      daySeconds += 86400;
+      --days;
+    }
+
+    // days since epoch to proleptic Gregorian date, eras of 400 years
+    days += 719468;
+    qint64 const era = (days >= 0 ? days : days - 146096) / 146097;
+    qint64 const dayOfEra = days - era * 146097;
+    qint64 const yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    qint64 const dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    qint64 const shiftedMonth = (5 * dayOfYear + 2) / 153;
+    qint64 const day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    qint64 const month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    qint64 const year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    PutNumber(year);
+    Put('-');
+    PutTwoDigits(month);
+    Put('-');
+    PutTwoDigits(day);
+    Put('T');
+    PutTwoDigits(daySeconds / 3600);
+    Put(':');
+    PutTwoDigits(daySeconds / 60 % 60);
+    Put(':');
+    PutTwoDigits(daySeconds % 60);
+    Put('Z');
+  }
+
+  /// UTF-16 to UTF-8, an unpaired surrogate becomes U+FFFD
+  void PutText(QChar const * text, int length, EEscape escape)
+  {
+    for (int i = 0; i < length; ++i)
+    {
+      uint code = text[i].unicode();
+      if ((code & 0xFC00) == 0xD800 && i + 1 < length && (text[i + 1].unicode() & 0xFC00) == 0xDC00)
+        code = 0x10000 + ((code - 0xD800) << 10) + (text[++i].unicode() - 0xDC00);
+      else if ((code & 0xF800) == 0xD800)
+        code = 0xFFFD;
+
+      if (code < 0x80)
+        PutAscii(static_cast<char>(code), escape);
+      else if (code < 0x800)
+      {
+        Put(static_cast<char>(0xC0 | code >> 6));
+        Put(static_cast<char>(0x80 | (code & 0x3F)));
+      }
+      else if (code < 0x10000)
+      {
+        Put(static_cast<char>(0xE0 | code >> 12));
+        Put(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+        Put(static_cast<char>(0x80 | (code & 0x3F)));
+      }
+      else
+      {
+        Put(static_cast<char>(0xF0 | code >> 18));
+        Put(static_cast<char>(0x80 | (code >> 12 & 0x3F)));
+        Put(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+        Put(static_cast<char>(0x80 | (code & 0x3F)));
+      }
+    }
+  }
+
+private:
+  void PutTwoDigits(qint64 value)
+  {
+    Put(static_cast<char>('0' + value / 10));
+    Put(static_cast<char>('0' + value % 10));
+  }
+
+  void PutAscii(char c, EEscape escape)
+  {
+    if (escape == TsvEscape)
+    {
+      switch (c)
+      {
+      case '\\': Put("\\\\"); return;
+      case '\t': Put("\\t"); return;
+      case '\n': Put("\\n"); return;
+      case '\r': Put("\\r"); return;
+      }
+    }
+    else if (escape == JsonEscape)
+    {
+      switch (c)
+      {
+      case '"': Put("\\\""); return;
+      case '\\': Put("\\\\"); return;
+      case '\t': Put("\\t"); return;
+      case '\n': Put("\\n"); return;
+      case '\r': Put("\\r"); return;
+      }
+
+      if (static_cast<unsigned char>(c) < 0x20)
+      {
+        Put("\\u00");
+        Put("0123456789abcdef"[c >> 4]);
+        Put("0123456789abcdef"[c & 0xF]);
+        return;
+      }
+    }
+
+    Put(c);
+  }
+
+  QFile & m_file;
+  std::vector<char> m_buffer;
+  size_t m_used = 0;
+  bool m_isFailed = false;
+};
+
+/// One line per entry in the chosen format
+class EntryWriter
+{
+public:
+  EntryWriter(BufferedWriter & writer, Exporter::EFormat format, int columns)
+    : m_writer(writer)
+    , m_format(format)
+    , m_columns(columns)
+  {
+  }
+
+  void WriteHeader()
+  {
+    if (m_format != Exporter::Tsv)
+      return;
+
+    m_writer.Put("path");
+    if (m_columns & Exporter::SizeColumn)
+      m_writer.Put("\tsize");
+    if (m_columns & Exporter::ModifiedColumn)
+      m_writer.Put("\tmodified");
+    if (m_columns & Exporter::CreatedColumn)
+      m_writer.Put("\tcreated");
+    if (m_columns & Exporter::OwnerColumn)
+      m_writer.Put("\towner");
+    if (m_columns & Exporter::PermissionsColumn)
+      m_writer.Put("\tpermissions");
+    m_writer.Put('\n');
+  }
+
+  void Write(QChar const * path, int pathLength, EntryInfo const & info)
+  {
+    ++m_count;
+    if (m_format == Exporter::NulSeparated)
+    {
+      m_writer.PutText(path, pathLength, NoEscape);
+      m_writer.Put('\0');
+      return;
+    }
+
+    bool const isJson = m_format == Exporter::JsonLines;
+    EEscape const escape = isJson ? JsonEscape : TsvEscape;
+
+    if (isJson)
+      m_writer.Put("{\"path\":\"");
+    m_writer.PutText(path, pathLength, escape);
+    if (isJson)
+    {
+      m_writer.Put("\",\"dir\":");
+      m_writer.Put(info.IsDir() ? "true" : "false");
+    }
+
+    // directories have no size, the same as in the views
+    if (m_columns & Exporter::SizeColumn)
+    {
+      BeginField("size");
+      if (!info.IsDir())
+        m_writer.PutNumber(info.m_size);
+      else if (isJson)
+        m_writer.Put("null");
+    }
+
+    if (m_columns & Exporter::ModifiedColumn)
+      WriteTime("modified", info.m_modifiedTime);
+    if (m_columns & Exporter::CreatedColumn)
+      WriteTime("created", info.m_createdTime);
+
+    if (m_columns & Exporter::OwnerColumn)
+    {
+      QString const owner = GetOwnerName(info.m_ownerId);
+      BeginField("owner");
+      WriteString(owner.constData(), owner.size());
+    }
+
+    if (m_columns & Exporter::PermissionsColumn)
+    {
+      BeginField("permissions");
+      if (isJson)
+        m_writer.Put('"');
+      m_writer.PutHex(info.m_permissions);
+      if (isJson)
+        m_writer.Put('"');
+    }
+
+    if (isJson)
+      m_writer.Put('}');
+    m_writer.Put('\n');
+  }
+
+  quint64 GetCount() const
+  {
+    return m_count;
+  }
+
+private:
+  void BeginField(char const * name)
+  {
+    if (m_format == Exporter::Tsv)
+    {
+      m_writer.Put('\t');
+      return;
+    }
+
+    m_writer.Put(",\"");
+    m_writer.Put(name);
+    m_writer.Put("\":");
+  }
+
+  void WriteString(QChar const * text, int length)
+  {
+    if (m_format == Exporter::Tsv)
+    {
+      m_writer.PutText(text, length, TsvEscape);
+      return;
+    }
+
+    m_writer.Put('"');
+    m_writer.PutText(text, length, JsonEscape);
+    m_writer.Put('"');
+  }
+
+  void WriteTime(char const * name, qint64 time)
+  {
+    BeginField(name);
+    bool const isJson = m_format == Exporter::JsonLines;
+    if (time == EntryInfo::InvalidTime)
+    {
+      if (isJson)
+        m_writer.Put("null");
+      return;
+    }
+
+    if (isJson)
+      m_writer.Put('"');
+    m_writer.PutTime(time);
+    if (isJson)
+      m_writer.Put('"');
+  }
+
+  BufferedWriter & m_writer;
+  Exporter::EFormat m_format;
+  int m_columns;
+  quint64 m_count = 0;
+};
+
+/// Directory below an entry that was not scanned, listed by the exporter itself
+struct ExpandDir
+{
+  std::unique_ptr<DirLister> m_lister;
+  /// where the names of its entries start in the path buffer, without the separator
+  int m_pathLength = 0;
+  QString m_relativePath;
+  TIgnoreRules m_rules;
+};
+
+} // namespace
+
+Exporter::Exporter(ExportSnapshot && snapshot, QString const & target, EFormat format, int columns)
+  : m_snapshot(std::move(snapshot))
+  , m_target(target)
+  , m_format(format)
+  , m_columns(columns)
+  , m_canceled(false)
+{
+}
+
+void Exporter::run()
+{
+  bool const toStdout = m_target == "-";
+  QFile file(toStdout ? QString() : m_target);
+  bool const isOpened = toStdout ? file.open(stdout, QIODevice::WriteOnly)
+                                 : file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  if (!isOpened)
+  {
+    emit exportFinished(0, file.errorString(), this);
+    return;
+  }
+
+  BufferedWriter writer(file);
+  EntryWriter entryWriter(writer, m_format, m_columns);
+  entryWriter.WriteHeader();
+
+  QElapsedTimer timer;
+  timer.start();
+  auto reportProgress = [&]()
+  {
+    if (timer.elapsed() < ProgressTimeout)
+      return;
+
+    emit progress(entryWriter.GetCount(), this);
+    timer.restart();
+  };
+
+  // the path of the current entry, prefixLength[d] is where a child of the depth d entry starts
+  std::vector<QChar> path;
+  std::vector<int> prefixLength;
+  int rootIndex = 0;
+  size_t expandIndex = 0;
+  NamePool const & pool = *m_snapshot.m_pool;
+  for (ExportEntry const & entry : m_snapshot.m_entries)
+  {
+    if (m_canceled == true || writer.IsFailed())
+      break;
+
+    if (entry.m_depth == 0)
+    {
+      Q_ASSERT(rootIndex < m_snapshot.m_rootPaths.size());
+      QString const & rootPath = m_snapshot.m_rootPaths[rootIndex++];
+      path.assign(rootPath.constData(), rootPath.constData() + rootPath.size());
+      // the root of a drive already ends with a separator
+      prefixLength.assign(1, rootPath.endsWith('/') ? static_cast<int>(path.size()) - 1
+                                                    : static_cast<int>(path.size()));
+    }
+    else
+    {
+      Q_ASSERT(entry.m_depth <= prefixLength.size());
+      NameRef const name = entry.m_info.m_name;
+      path.resize(prefixLength[entry.m_depth - 1]);
+      path.push_back(QChar('/'));
+      path.insert(path.end(), pool.Data(name), pool.Data(name) + name.m_length);
+
+      prefixLength.resize(entry.m_depth + 1);
+      prefixLength[entry.m_depth] = static_cast<int>(path.size());
+    }
+
+    if (entry.m_checked)
+      entryWriter.Write(path.data(), static_cast<int>(path.size()), entry.m_info);
+
+    if (entry.m_expand)
+    {
+      Q_ASSERT(expandIndex < m_snapshot.m_expandRoots.size());
+      CrawlRoot const & expandRoot = m_snapshot.m_expandRoots[expandIndex++];
+
+      // a lister per open directory, listed names are appended to path in place and the stat
+      // of the listing is the only one per entry
+      std::vector<ExpandDir> dirs;
+      auto openDir = [&](int pathLength, QString const & relativePath, TIgnoreRules const & rules)
+      {
+        QString const dirPath(path.data(), pathLength);
+        ExpandDir dir;
+        dir.m_lister.reset(new DirLister(dirPath));
+        dir.m_pathLength = dirPath.endsWith('/') ? pathLength - 1 : pathLength;
+        dir.m_relativePath = relativePath;
+        dir.m_rules = expandRoot.m_readGitIgnore ? ReadGitIgnore(rules, dirPath, relativePath) : rules;
+        dirs.push_back(std::move(dir));
+      };
+      openDir(static_cast<int>(path.size()), expandRoot.m_relativePath, expandRoot.m_rules);
+
+      ListedEntry listed;
+      while (!dirs.empty() && m_canceled == false && !writer.IsFailed())
+      {
+        ExpandDir & dir = dirs.back();
+        if (!dir.m_lister->Next(listed))
+        {
+          dirs.pop_back();
+          continue;
+        }
+
+        // the same entries the scaners list
+        if (listed.m_isHidden || listed.m_isDangling)
+          continue;
+
+        QString const name = QString::fromRawData(listed.m_name, listed.m_nameLength);
+        bool const isDir = listed.m_stat.m_isDir;
+        // an excluded directory is never opened, so nothing below it is read
+        if (dir.m_rules != nullptr && dir.m_rules->IsExcluded(dir.m_relativePath, name, isDir))
+          continue;
+
+        path.resize(dir.m_pathLength);
+        path.push_back(QChar('/'));
+        path.insert(path.end(), listed.m_name, listed.m_name + listed.m_nameLength);
+        entryWriter.Write(path.data(), static_cast<int>(path.size()), MakeEntryInfo(listed.m_stat, listed.m_isSymLink));
+        reportProgress();
+
+        if (isDir && !listed.m_isSymLink)
+        {
+          QString const relativePath = dir.m_relativePath.isEmpty() ? name : dir.m_relativePath + '/' + name;
+          TIgnoreRules const rules = dir.m_rules;
+          openDir(static_cast<int>(path.size()), relativePath, rules);
+        }
+      }
+    }
+
+    reportProgress();
+  }
+
+  QString error;
+  if (!writer.Flush() || !file.flush())
+    error = file.errorString();
+  else if (m_canceled == true)
+    error = QStringLiteral("Export canceled");
+
+  emit exportFinished(entryWriter.GetCount(), error, this);
+}
+
+void Exporter::cancel()
+{
+  m_canceled = true;
+}
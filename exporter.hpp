@@ -0,0 +1,76 @@
+#pragma once
+
+#include "entry_info.hpp"
+#include "parallel_crawler.hpp"
+
+#include <QObject>
+#include <QRunnable>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// Checked or partially checked entry of the tree, snapshots list them in pre-order
+struct ExportEntry
+{
+  EntryInfo m_info;
+  quint32 m_depth = 0;
+  /// partially checked entries are only the way to their checked children
+  bool m_checked = false;
+  /// fully checked directory that is not scanned completely, it is listed from disk
+  bool m_expand = false;
+};
+
+/// Taken on the GUI thread, names stay readable from the pool on the export thread
+struct ExportSnapshot
+{
+  std::shared_ptr<NamePool> m_pool;
+  /// paths of the entries with depth 0 in their order, one per root
+  QStringList m_rootPaths;
+  std::vector<ExportEntry> m_entries;
+  /// relative paths and exclusion rules of the entries with m_expand in their order
+  std::vector<CrawlRoot> m_expandRoots;
+};
+
+class Exporter : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  enum EFormat
+  {
+    Tsv,
+    JsonLines,
+    /// only paths, each terminated by '\0', for xargs -0
+    NulSeparated
+  };
+
+  enum EColumn
+  {
+    SizeColumn = 1,
+    ModifiedColumn = 2,
+    CreatedColumn = 4,
+    OwnerColumn = 8,
+    PermissionsColumn = 16,
+    AllColumns = 31
+  };
+
+  /// "-" as target writes to stdout
+  Exporter(ExportSnapshot && snapshot, QString const & target, EFormat format, int columns);
+
+  Q_SIGNAL void progress(quint64 entryCount, Exporter * exporter);
+  /// error is empty when everything was written
+  Q_SIGNAL void exportFinished(quint64 entryCount, QString const & error, Exporter * exporter);
+
+  void cancel();
+
+protected:
+  void run();
+
+private:
+  ExportSnapshot m_snapshot;
+  QString m_target;
+  EFormat m_format;
+  int m_columns;
+  std::atomic<bool> m_canceled;
+};
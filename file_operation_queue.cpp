@@ -0,0 +1,124 @@
+#include "file_operation_queue.hpp"
+#include "macros.hpp"
+
+#include <QFileInfo>
+
+namespace
+{
+
+/// Enough to overlap metadata latency, few enough to not thrash a spinning disk
+int const DefaultParallelism = 4;
+
+} // namespace
+
+FileOperationQueue::FileOperationQueue(QObject * parent)
+  : QObject(parent)
+  , m_canceled(std::make_shared<std::atomic<bool> >(false))
+{
+  m_pool.setMaxThreadCount(DefaultParallelism);
+}
+
+FileOperationQueue::~FileOperationQueue()
+{
+  cancel();
+  m_pool.waitForDone();
+
+  // finished signals of the last tasks are still queued
+  for (FileOperationTask * task : m_tasks)
+    delete task;
+}
+
+void FileOperationQueue::setMaxParallelism(int count)
+{
+  m_pool.setMaxThreadCount(std::max(1, count));
+}
+
+bool FileOperationQueue::start(FileOperationTask::EOperation operation, QStringList const & sourcePaths,
+                               QString const & targetDir)
+{
+  if (isRunning())
+    return false;
+
+  m_canceled = std::make_shared<std::atomic<bool> >(false);
+  m_finishedCount = 0;
+  m_totalCount = sourcePaths.size();
+  m_errorCount = 0;
+  m_entryCount = 0;
+  m_byteCount = 0;
+
+  for (QString const & sourcePath : sourcePaths)
+  {
+    FileOperationTask * task = new FileOperationTask(operation, sourcePath, targetDir, m_canceled, m_pool);
+    VERIFY(QObject::connect(task, &FileOperationTask::progress,
+                            this, &FileOperationQueue::taskProgress, Qt::QueuedConnection));
+    VERIFY(QObject::connect(task, &FileOperationTask::entryFailed,
+                            this, &FileOperationQueue::taskEntryFailed, Qt::QueuedConnection));
+    VERIFY(QObject::connect(task, &FileOperationTask::taskFinished,
+                            this, &FileOperationQueue::taskFinished, Qt::QueuedConnection));
+    task->setAutoDelete(false);
+
+    m_tasks.insert(task);
+    m_pool.start(task);
+  }
+
+  if (m_tasks.empty())
+    emit operationFinished(false, 0);
+
+  return true;
+}
+
+void FileOperationQueue::cancel()
+{
+  *m_canceled = true;
+}
+
+bool FileOperationQueue::isRunning() const
+{
+  return !m_tasks.empty();
+}
+
+void FileOperationQueue::taskProgress(quint64 entryCount, qint64 byteCount, FileOperationTask * task)
+{
+  if (m_tasks.count(task) == 0)
+    return;
+
+  m_entryCount += entryCount;
+  m_byteCount += byteCount;
+  emitProgress();
+}
+
+void FileOperationQueue::taskEntryFailed(QString const & path, QString const & error, FileOperationTask * task)
+{
+  if (m_tasks.count(task) == 0)
+    return;
+
+  ++m_errorCount;
+  emit entryFailed(path, error);
+}
+
+void FileOperationQueue::taskFinished(FileOperationTask * task)
+{
+  if (m_tasks.erase(task) == 0)
+    return;
+
+  ++m_finishedCount;
+  emitProgress();
+
+  // rows are updated after every entry, the parent of the source lost it, the target got it
+  QStringList dirs;
+  if (task->operation() != FileOperationTask::Copy)
+    dirs.append(QFileInfo(task->sourcePath()).absolutePath());
+  if (task->operation() != FileOperationTask::Delete)
+    dirs.append(task->targetDir());
+  emit dirsChanged(dirs);
+
+  task->deleteLater();
+
+  if (m_tasks.empty())
+    emit operationFinished(*m_canceled, m_errorCount);
+}
+
+void FileOperationQueue::emitProgress()
+{
+  emit progress(m_finishedCount, m_totalCount, m_entryCount, m_byteCount);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "file_operation_task.hpp"
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <set>
+
+/// Runs one copy, move or delete of checked entries on its own bounded pool,
+/// every topmost checked entry is a separate task and every directory below it a separate job
+class FileOperationQueue : public QObject
+{
+  Q_OBJECT
+
+public:
+  FileOperationQueue(QObject * parent = 0);
+  ~FileOperationQueue();
+
+  /// How many directories are processed at the same time, applies to a running operation as well
+  void setMaxParallelism(int count);
+
+  /// false when an operation is already running
+  bool start(FileOperationTask::EOperation operation, QStringList const & sourcePaths, QString const & targetDir);
+  void cancel();
+  bool isRunning() const;
+
+  Q_SIGNAL void progress(int finishedCount, int totalCount, quint64 entryCount, qint64 byteCount);
+  Q_SIGNAL void entryFailed(QString const & path, QString const & error);
+  /// Directories whose listing changed after one of the entries was processed
+  Q_SIGNAL void dirsChanged(QStringList const & paths);
+  Q_SIGNAL void operationFinished(bool canceled, int errorCount);
+
+private:
+  Q_SLOT void taskProgress(quint64 entryCount, qint64 byteCount, FileOperationTask * task);
+  Q_SLOT void taskEntryFailed(QString const & path, QString const & error, FileOperationTask * task);
+  Q_SLOT void taskFinished(FileOperationTask * task);
+
+  void emitProgress();
+
+private:
+  QThreadPool m_pool;
+  std::shared_ptr<std::atomic<bool> > m_canceled;
+  std::set<FileOperationTask *> m_tasks;
+
+  int m_finishedCount = 0;
+  int m_totalCount = 0;
+  int m_errorCount = 0;
+  quint64 m_entryCount = 0;
+  qint64 m_byteCount = 0;
+};
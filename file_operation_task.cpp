@@ -0,0 +1,671 @@
+#include "file_operation_task.hpp"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+
+#ifdef Q_OS_UNIX
+  #include <cerrno>
+  #include <cstdio>
+  #include <cstring>
+  #include <dirent.h>
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+  #include <linux/fs.h>
+  #include <sys/ioctl.h>
+#endif
+
+namespace
+{
+
+size_t const CopyBufferSize = 1 << 20;
+qint64 const ProgressTimeout = 100;
+
+} // namespace
+
+FileOperationTask::FileOperationTask(EOperation operation, QString const & sourcePath, QString const & targetDir,
+                                     std::shared_ptr<std::atomic<bool> > const & canceled, QThreadPool & pool)
+  : m_operation(operation)
+  , m_sourcePath(sourcePath)
+  , m_targetDir(targetDir)
+  , m_canceled(canceled)
+  , m_pool(pool)
+{
+}
+
+/// Directory below the entry, it is finalized when its own listing and all its subdirectories are done
+struct FileOperationTask::Dir
+{
+  Dir(TDir const & parent, QByteArray const & source, QByteArray const & target, bool isRemoving)
+    : m_parent(parent)
+    , m_source(source)
+    , m_target(target)
+    , m_isRemoving(isRemoving)
+    , m_pending(1)
+    , m_isFailed(false)
+  {
+  }
+
+  TDir m_parent;
+  QByteArray m_source;
+  /// empty when removing
+  QByteArray m_target;
+  bool m_isRemoving;
+  /// mode restored on the copied directory, -1 until it is created
+  int m_mode = -1;
+  /// the own listing and the subdirectories not finished yet
+  std::atomic<int> m_pending;
+  std::atomic<bool> m_isFailed;
+};
+
+class FileOperationTask::DirJob : public QRunnable
+{
+public:
+  DirJob(FileOperationTask & task, TDir const & dir)
+    : m_task(task)
+    , m_dir(dir)
+  {
+  }
+
+protected:
+  void run()
+  {
+    m_task.ProcessDir(m_dir, m_buffer);
+  }
+
+private:
+  FileOperationTask & m_task;
+  TDir m_dir;
+  std::vector<char> m_buffer;
+};
+
+FileOperationTask::EOperation FileOperationTask::operation() const
+{
+  return m_operation;
+}
+
+QString const & FileOperationTask::sourcePath() const
+{
+  return m_sourcePath;
+}
+
+QString const & FileOperationTask::targetDir() const
+{
+  return m_targetDir;
+}
+
+void FileOperationTask::run()
+{
+  {
+    QMutexLocker lock(&m_progressMutex);
+    m_progressTimer.start();
+  }
+
+  m_source = QFile::encodeName(QDir::cleanPath(m_sourcePath));
+  m_target = QFile::encodeName(QDir::cleanPath(m_targetDir + '/' + QFileInfo(m_sourcePath).fileName()));
+
+  // a directory copied into itself would never end
+  QString const sourcePrefix = QDir::cleanPath(m_sourcePath) + '/';
+  if (m_operation != Delete && (QDir::cleanPath(m_targetDir) + '/').startsWith(sourcePrefix))
+  {
+    Fail(m_source, QStringLiteral("Target is inside the source"));
+    Finish();
+    return;
+  }
+
+  if (IsCanceled())
+  {
+    Finish();
+    return;
+  }
+
+  std::vector<char> buffer;
+  switch (m_operation)
+  {
+  case Copy:
+    StartCopy(buffer);
+    break;
+  case Move:
+  {
+    bool isCrossDevice = false;
+    if (RenameEntry(m_source, m_target, isCrossDevice))
+    {
+      AddProgress(1, 0);
+      Finish();
+    }
+    // another filesystem, the source is removed only when everything was copied
+    else if (isCrossDevice)
+      StartCopy(buffer);
+    else
+      Finish();
+    break;
+  }
+  case Delete:
+    StartRemove();
+    break;
+  }
+}
+
+void FileOperationTask::StartCopy(std::vector<char> & buffer)
+{
+  if (!IsDirEntry(m_source))
+    EntryDone(CopyEntry(m_source, m_target, buffer), false);
+  else
+    ProcessDir(std::make_shared<Dir>(TDir(), m_source, m_target, false), buffer);
+}
+
+void FileOperationTask::StartRemove()
+{
+  if (!IsDirEntry(m_source))
+  {
+    EntryDone(RemoveFile(m_source), true);
+    return;
+  }
+
+  std::vector<char> buffer;
+  ProcessDir(std::make_shared<Dir>(TDir(), m_source, QByteArray(), true), buffer);
+}
+
+void FileOperationTask::ProcessDir(TDir const & dir, std::vector<char> & buffer)
+{
+  std::vector<QByteArray> files;
+  std::vector<QByteArray> dirs;
+  bool isListed = !IsCanceled();
+  if (isListed && !dir->m_isRemoving)
+    isListed = MakeDir(dir->m_source, dir->m_target, dir->m_mode);
+  if (!isListed || !ListDir(dir->m_source, files, dirs))
+  {
+    dir->m_isFailed = true;
+    FinishDir(dir);
+    return;
+  }
+
+  // subdirectories first, idle threads of the pool take them while the files are processed here
+  for (QByteArray const & name : dirs)
+  {
+    QByteArray const target = dir->m_isRemoving ? QByteArray() : dir->m_target + '/' + name;
+    ++dir->m_pending;
+    m_pool.start(new DirJob(*this, std::make_shared<Dir>(dir, dir->m_source + '/' + name, target, dir->m_isRemoving)));
+  }
+
+  for (QByteArray const & name : files)
+  {
+    if (IsCanceled())
+    {
+      dir->m_isFailed = true;
+      break;
+    }
+
+    QByteArray const source = dir->m_source + '/' + name;
+    bool const isDone = dir->m_isRemoving ? RemoveFile(source) : CopyEntry(source, dir->m_target + '/' + name, buffer);
+    if (!isDone)
+      dir->m_isFailed = true;
+  }
+
+  FinishDir(dir);
+}
+
+void FileOperationTask::FinishDir(TDir const & dir)
+{
+  // parents are kept alive by their children, the caller keeps dir
+  for (Dir * current = dir.get(); current != nullptr; current = current->m_parent.get())
+  {
+    if (--current->m_pending > 0)
+      return;
+
+    if (IsCanceled())
+      current->m_isFailed = true;
+
+    // a directory with a failed entry is left in place
+    if (current->m_isRemoving && !current->m_isFailed && !RemoveDir(current->m_source))
+      current->m_isFailed = true;
+
+    if (!current->m_isRemoving && current->m_mode >= 0)
+    {
+      SetDirMode(current->m_target, current->m_mode);
+      AddProgress(1, 0);
+    }
+
+    if (current->m_parent == nullptr)
+    {
+      EntryDone(!current->m_isFailed, current->m_isRemoving);
+      return;
+    }
+
+    if (current->m_isFailed)
+      current->m_parent->m_isFailed = true;
+  }
+}
+
+void FileOperationTask::EntryDone(bool isDone, bool wasRemoving)
+{
+  if (m_operation == Move && !wasRemoving && isDone)
+    StartRemove();
+  else
+    Finish();
+}
+
+void FileOperationTask::Finish()
+{
+  FlushProgress();
+  emit taskFinished(this);
+}
+
+bool FileOperationTask::IsCanceled() const
+{
+  return *m_canceled == true;
+}
+
+void FileOperationTask::Fail(QByteArray const & path, QString const & error)
+{
+  emit entryFailed(QFile::decodeName(path), error, this);
+}
+
+void FileOperationTask::AddProgress(quint64 entryCount, qint64 byteCount)
+{
+  QMutexLocker lock(&m_progressMutex);
+  m_entryCount += entryCount;
+  m_byteCount += byteCount;
+  if (m_progressTimer.elapsed() < ProgressTimeout)
+    return;
+
+  lock.unlock();
+  FlushProgress();
+}
+
+void FileOperationTask::FlushProgress()
+{
+  QMutexLocker lock(&m_progressMutex);
+  quint64 const entryCount = m_entryCount;
+  qint64 const byteCount = m_byteCount;
+  m_entryCount = 0;
+  m_byteCount = 0;
+  m_progressTimer.restart();
+  lock.unlock();
+
+  if (entryCount > 0 || byteCount > 0)
+    emit progress(entryCount, byteCount, this);
+}
+
+#ifdef Q_OS_UNIX
+
+void FileOperationTask::Fail(QByteArray const & path, int error)
+{
+  Fail(path, QString::fromLocal8Bit(std::strerror(error)));
+}
+
+bool FileOperationTask::IsDirEntry(QByteArray const & path)
+{
+  struct stat pathStat;
+  return ::lstat(path.constData(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode);
+}
+
+bool FileOperationTask::ListDir(QByteArray const & path, std::vector<QByteArray> & files, std::vector<QByteArray> & dirs)
+{
+  DIR * dir = ::opendir(path.constData());
+  if (dir == nullptr)
+  {
+    Fail(path, errno);
+    return false;
+  }
+
+  while (dirent * entry = ::readdir(dir))
+  {
+    if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+      continue;
+
+    bool isDir = entry->d_type == DT_DIR;
+    if (entry->d_type == DT_UNKNOWN)
+    {
+      struct stat entryStat;
+      isDir = ::fstatat(::dirfd(dir), entry->d_name, &entryStat, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(entryStat.st_mode);
+    }
+
+    if (isDir)
+      dirs.push_back(QByteArray(entry->d_name));
+    else
+      files.push_back(QByteArray(entry->d_name));
+  }
+  ::closedir(dir);
+  return true;
+}
+
+bool FileOperationTask::MakeDir(QByteArray const & source, QByteArray const & target, int & mode)
+{
+  struct stat sourceStat;
+  if (::lstat(source.constData(), &sourceStat) != 0)
+  {
+    Fail(source, errno);
+    return false;
+  }
+
+  // owner gets write access until the content is copied, the mode is restored after
+  if (::mkdir(target.constData(), (sourceStat.st_mode & 07777) | S_IRWXU) != 0)
+  {
+    Fail(target, errno);
+    return false;
+  }
+
+  mode = sourceStat.st_mode & 07777;
+  return true;
+}
+
+void FileOperationTask::SetDirMode(QByteArray const & path, int mode)
+{
+  ::chmod(path.constData(), mode);
+}
+
+bool FileOperationTask::CopyEntry(QByteArray const & source, QByteArray const & target, std::vector<char> & buffer)
+{
+  if (IsCanceled())
+    return false;
+
+  struct stat sourceStat;
+  if (::lstat(source.constData(), &sourceStat) != 0)
+  {
+    Fail(source, errno);
+    return false;
+  }
+
+  if (S_ISREG(sourceStat.st_mode))
+    return CopyFile(source, target, sourceStat.st_mode & 07777, buffer);
+
+  if (S_ISLNK(sourceStat.st_mode))
+  {
+    std::vector<char> linkTarget(static_cast<size_t>(sourceStat.st_size) + 1);
+    ssize_t const length = ::readlink(source.constData(), linkTarget.data(), linkTarget.size() - 1);
+    if (length < 0 || ::symlink(QByteArray(linkTarget.data(), static_cast<int>(length)).constData(), target.constData()) != 0)
+    {
+      Fail(length < 0 ? source : target, errno);
+      return false;
+    }
+
+    AddProgress(1, 0);
+    return true;
+  }
+
+  Fail(source, QStringLiteral("Special files are not copied"));
+  return false;
+}
+
+bool FileOperationTask::CopyFile(QByteArray const & source, QByteArray const & target, int mode,
+                                 std::vector<char> & buffer)
+{
+  int const in = ::open(source.constData(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+  {
+    Fail(source, errno);
+    return false;
+  }
+
+  // never overwrite, an existing target is reported as an error
+  int const out = ::open(target.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+  if (out < 0)
+  {
+    Fail(target, errno);
+    ::close(in);
+    return false;
+  }
+
+  bool isCopied = CopyData(in, out, buffer);
+  if (!isCopied && errno != 0)
+    Fail(target, errno);
+
+  if (::close(out) != 0 && isCopied)
+  {
+    Fail(target, errno);
+    isCopied = false;
+  }
+  ::close(in);
+
+  if (!isCopied)
+    ::unlink(target.constData());
+  else
+    AddProgress(1, 0);
+
+  return isCopied;
+}
+
+/// Clone, then in-kernel copy, then a plain read/write loop. Returns false with errno 0 when canceled.
+bool FileOperationTask::CopyData(int in, int out, std::vector<char> & buffer)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+  // copy on write filesystems share the extents, nothing is read at all
+  if (::ioctl(out, FICLONE, in) == 0)
+  {
+    struct stat inStat;
+    if (::fstat(in, &inStat) == 0)
+      AddProgress(0, inStat.st_size);
+    return true;
+  }
+#endif
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+  for (;;)
+  {
+    if (IsCanceled())
+    {
+      errno = 0;
+      return false;
+    }
+
+    ssize_t const copied = ::copy_file_range(in, nullptr, out, nullptr, CopyBufferSize, 0);
+    if (copied > 0)
+    {
+      AddProgress(0, copied);
+      continue;
+    }
+
+    if (copied == 0)
+      return true;
+
+    if (errno == EINTR)
+      continue;
+
+    // not supported between these files, file offsets are left where the kernel stopped
+    if (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF)
+      break;
+
+    return false;
+  }
+#endif
+
+  if (buffer.empty())
+    buffer.resize(CopyBufferSize);
+
+  for (;;)
+  {
+    if (IsCanceled())
+    {
+      errno = 0;
+      return false;
+    }
+
+    ssize_t const readCount = ::read(in, buffer.data(), buffer.size());
+    if (readCount == 0)
+      return true;
+
+    if (readCount < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    for (ssize_t written = 0; written < readCount;)
+    {
+      ssize_t const count = ::write(out, buffer.data() + written, readCount - written);
+      if (count < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+
+      written += count;
+    }
+
+    AddProgress(0, readCount);
+  }
+}
+
+bool FileOperationTask::RenameEntry(QByteArray const & source, QByteArray const & target, bool & isCrossDevice)
+{
+  // rename silently replaces an existing file
+  struct stat targetStat;
+  if (::lstat(target.constData(), &targetStat) == 0)
+  {
+    Fail(target, EEXIST);
+    return false;
+  }
+
+  if (::rename(source.constData(), target.constData()) == 0)
+    return true;
+
+  if (errno == EXDEV)
+    isCrossDevice = true;
+  else
+    Fail(source, errno);
+
+  return false;
+}
+
+bool FileOperationTask::RemoveFile(QByteArray const & path)
+{
+  if (::unlink(path.constData()) != 0)
+  {
+    Fail(path, errno);
+    return false;
+  }
+
+  AddProgress(1, 0);
+  return true;
+}
+
+bool FileOperationTask::RemoveDir(QByteArray const & path)
+{
+  if (::rmdir(path.constData()) != 0)
+  {
+    Fail(path, errno);
+    return false;
+  }
+
+  AddProgress(1, 0);
+  return true;
+}
+
+#else
+
+void FileOperationTask::Fail(QByteArray const & path, int /*error*/)
+{
+  Fail(path, QStringLiteral("Operation failed"));
+}
+
+bool FileOperationTask::IsDirEntry(QByteArray const & path)
+{
+  QFileInfo const info(QFile::decodeName(path));
+  return info.isDir() && !info.isSymLink();
+}
+
+bool FileOperationTask::ListDir(QByteArray const & path, std::vector<QByteArray> & files, std::vector<QByteArray> & dirs)
+{
+  QFileInfo const info(QFile::decodeName(path));
+  if (!info.isReadable())
+  {
+    Fail(path, QStringLiteral("Cannot list directory"));
+    return false;
+  }
+
+  QDirIterator iter(info.absoluteFilePath(), QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+  while (iter.hasNext())
+  {
+    iter.next();
+    QFileInfo const entry = iter.fileInfo();
+    if (entry.isDir() && !entry.isSymLink())
+      dirs.push_back(QFile::encodeName(iter.fileName()));
+    else
+      files.push_back(QFile::encodeName(iter.fileName()));
+  }
+
+  return true;
+}
+
+bool FileOperationTask::MakeDir(QByteArray const & /*source*/, QByteArray const & target, int & mode)
+{
+  if (!QDir().mkdir(QFile::decodeName(target)))
+  {
+    Fail(target, QStringLiteral("Cannot create directory"));
+    return false;
+  }
+
+  mode = 0;
+  return true;
+}
+
+void FileOperationTask::SetDirMode(QByteArray const & /*path*/, int /*mode*/)
+{
+}
+
+bool FileOperationTask::CopyEntry(QByteArray const & source, QByteArray const & target, std::vector<char> & buffer)
+{
+  if (IsCanceled())
+    return false;
+
+  return CopyFile(source, target, 0, buffer);
+}
+
+bool FileOperationTask::CopyFile(QByteArray const & source, QByteArray const & target, int /*mode*/,
+                                 std::vector<char> & /*buffer*/)
+{
+  QFile file(QFile::decodeName(source));
+  if (!file.copy(QFile::decodeName(target)))
+  {
+    Fail(source, file.errorString());
+    return false;
+  }
+
+  AddProgress(1, file.size());
+  return true;
+}
+
+bool FileOperationTask::RenameEntry(QByteArray const & source, QByteArray const & target, bool & isCrossDevice)
+{
+  if (QFile::rename(QFile::decodeName(source), QFile::decodeName(target)))
+    return true;
+
+  // the reason is not reported, a copy tells what is wrong
+  isCrossDevice = true;
+  return false;
+}
+
+bool FileOperationTask::RemoveFile(QByteArray const & path)
+{
+  if (!QFile::remove(QFile::decodeName(path)))
+  {
+    Fail(path, QStringLiteral("Cannot remove file"));
+    return false;
+  }
+
+  AddProgress(1, 0);
+  return true;
+}
+
+bool FileOperationTask::RemoveDir(QByteArray const & path)
+{
+  if (!QDir().rmdir(QFile::decodeName(path)))
+  {
+    Fail(path, QStringLiteral("Cannot remove directory"));
+    return false;
+  }
+
+  AddProgress(1, 0);
+  return true;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QRunnable>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class QThreadPool;
+
+/// Copies, moves or deletes one checked entry with everything below it.
+/// Every directory below the entry is a separate job on the pool, so one big
+/// directory is processed by as many threads as the pool allows.
+class FileOperationTask : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  enum EOperation
+  {
+    Copy,
+    Move,
+    Delete
+  };
+
+  /// The entry keeps its name inside targetDir, targetDir is ignored by Delete.
+  /// canceled is shared by all tasks of one operation, the jobs of subdirectories run on pool.
+  FileOperationTask(EOperation operation, QString const & sourcePath, QString const & targetDir,
+                    std::shared_ptr<std::atomic<bool> > const & canceled, QThreadPool & pool);
+
+  EOperation operation() const;
+  QString const & sourcePath() const;
+  QString const & targetDir() const;
+
+  /// Counts since the previous signal
+  Q_SIGNAL void progress(quint64 entryCount, qint64 byteCount, FileOperationTask * task);
+  Q_SIGNAL void entryFailed(QString const & path, QString const & error, FileOperationTask * task);
+  /// Emitted by the thread that finished the last directory
+  Q_SIGNAL void taskFinished(FileOperationTask * task);
+
+protected:
+  void run();
+
+private:
+  struct Dir;
+  class DirJob;
+  using TDir = std::shared_ptr<Dir>;
+
+  void StartCopy(std::vector<char> & buffer);
+  void StartRemove();
+  void ProcessDir(TDir const & dir, std::vector<char> & buffer);
+  /// The listing of dir is done, directories whose subtree is complete are finalized bottom up
+  void FinishDir(TDir const & dir);
+  /// The whole entry is copied or removed, a move across devices removes the source next
+  void EntryDone(bool isDone, bool wasRemoving);
+  void Finish();
+
+  bool IsDirEntry(QByteArray const & path);
+  bool ListDir(QByteArray const & path, std::vector<QByteArray> & files, std::vector<QByteArray> & dirs);
+  /// Creates the target writable by the owner, mode receives the mode to restore after the copy
+  bool MakeDir(QByteArray const & source, QByteArray const & target, int & mode);
+  void SetDirMode(QByteArray const & path, int mode);
+  /// Files, links and special entries, never directories
+  bool CopyEntry(QByteArray const & source, QByteArray const & target, std::vector<char> & buffer);
+  bool CopyFile(QByteArray const & source, QByteArray const & target, int mode, std::vector<char> & buffer);
+  bool CopyData(int in, int out, std::vector<char> & buffer);
+  /// isCrossDevice is set when the entry has to be copied and removed instead
+  bool RenameEntry(QByteArray const & source, QByteArray const & target, bool & isCrossDevice);
+  bool RemoveFile(QByteArray const & path);
+  bool RemoveDir(QByteArray const & path);
+
+  bool IsCanceled() const;
+  void Fail(QByteArray const & path, QString const & error);
+  void Fail(QByteArray const & path, int error);
+  void AddProgress(quint64 entryCount, qint64 byteCount);
+  void FlushProgress();
+
+  EOperation m_operation;
+  QString m_sourcePath;
+  QString m_targetDir;
+  std::shared_ptr<std::atomic<bool> > m_canceled;
+  QThreadPool & m_pool;
+
+  /// set by run before any job starts
+  QByteArray m_source;
+  QByteArray m_target;
+
+  /// jobs of several threads report into the same counters
+  QMutex m_progressMutex;
+  quint64 m_entryCount = 0;
+  qint64 m_byteCount = 0;
+  QElapsedTimer m_progressTimer;
+};
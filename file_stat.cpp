@@ -0,0 +1,291 @@
+#include "file_stat.hpp"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#include <vector>
+
+#ifdef Q_OS_WIN
+  #include <qt_windows.h>
+#else
+  #include <dirent.h>
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+
+#ifdef Q_OS_WIN
+qint64 FileTimeToNanoseconds(FILETIME const & time)
+{
+  quint64 ticks = (static_cast<quint64>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+  return static_cast<qint64>(ticks) * 100;
+}
+#else
+template <typename TStat>
+qint64 ModifiedTime(TStat const & st)
+{
+#if defined(Q_OS_LINUX)
+  return static_cast<qint64>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#elif defined(Q_OS_MAC)
+  return static_cast<qint64>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  return static_cast<qint64>(st.st_mtime) * 1000000000;
+#endif
+}
+
+template <typename TStat>
+qint64 ChangedTime(TStat const & st)
+{
+#if defined(Q_OS_LINUX)
+  return static_cast<qint64>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+#elif defined(Q_OS_MAC)
+  return static_cast<qint64>(st.st_ctimespec.tv_sec) * 1000000000 + st.st_ctimespec.tv_nsec;
+#else
+  return static_cast<qint64>(st.st_ctime) * 1000000000;
+#endif
+}
+
+/// The user bits are those that apply to the current user, as QFileInfo reports them
+quint16 ToPermissions(mode_t mode, uid_t owner)
+{
+  static uid_t const s_user = ::geteuid();
+  quint16 const ownerBits = (mode >> 6) & 7;
+  quint16 const groupBits = (mode >> 3) & 7;
+  quint16 const otherBits = mode & 7;
+  quint16 const userBits = owner == s_user ? ownerBits : otherBits;
+  return static_cast<quint16>(ownerBits << 12 | userBits << 8 | groupBits << 4 | otherBits);
+}
+
+void FillFileStat(struct stat const & st, FileStat & fileStat)
+{
+  fileStat.m_device = st.st_dev;
+  fileStat.m_inode = st.st_ino;
+  fileStat.m_size = st.st_size;
+  fileStat.m_modifiedTime = ModifiedTime(st);
+  fileStat.m_changedTime = ChangedTime(st);
+  fileStat.m_createdTime = fileStat.m_changedTime;
+  fileStat.m_linkCount = st.st_nlink;
+  fileStat.m_permissions = ToPermissions(st.st_mode, st.st_uid);
+  fileStat.m_ownerId = st.st_uid;
+  fileStat.m_isDir = S_ISDIR(st.st_mode);
+}
+
+/// Names on disk are taken as UTF-8, bytes that do not decode become U+FFFD
+void DecodeName(char const * name, std::vector<QChar> & buffer)
+{
+  buffer.clear();
+  unsigned char const * next = reinterpret_cast<unsigned char const *>(name);
+  while (*next != 0)
+  {
+    uint const first = *next++;
+    int extraCount = 0;
+    uint code = first;
+    if ((first & 0xE0) == 0xC0)
+    {
+      code = first & 0x1F;
+      extraCount = 1;
+    }
+    else if ((first & 0xF0) == 0xE0)
+    {
+      code = first & 0x0F;
+      extraCount = 2;
+    }
+    else if ((first & 0xF8) == 0xF0)
+    {
+      code = first & 0x07;
+      extraCount = 3;
+    }
+    else if (first >= 0x80)
+      extraCount = -1;
+
+    for (; extraCount > 0 && (*next & 0xC0) == 0x80; --extraCount)
+      code = code << 6 | (*next++ & 0x3F);
+
+    if (extraCount != 0 || code > 0x10FFFF)
+      buffer.push_back(QChar(0xFFFD));
+    else if (code >= 0x10000)
+    {
+      buffer.push_back(QChar(static_cast<ushort>(0xD800 + ((code - 0x10000) >> 10))));
+      buffer.push_back(QChar(static_cast<ushort>(0xDC00 + ((code - 0x10000) & 0x3FF))));
+    }
+    else
+      buffer.push_back(QChar(static_cast<ushort>(code)));
+  }
+}
+#endif
+
+} // namespace
+
+bool operator == (FileStat const & l, FileStat const & r)
+{
+  return l.m_device == r.m_device &&
+         l.m_inode == r.m_inode &&
+         l.m_size == r.m_size &&
+         l.m_modifiedTime == r.m_modifiedTime &&
+         l.m_changedTime == r.m_changedTime;
+}
+
+bool operator != (FileStat const & l, FileStat const & r)
+{
+  return !(l == r);
+}
+
+bool ReadFileStat(QString const & path, FileStat & fileStat)
+{
+#ifdef Q_OS_WIN
+  HANDLE handle = ::CreateFileW(reinterpret_cast<wchar_t const *>(path.utf16()), 0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+  if (handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  BY_HANDLE_FILE_INFORMATION info;
+  bool const result = ::GetFileInformationByHandle(handle, &info) != FALSE;
+  ::CloseHandle(handle);
+  if (!result)
+    return false;
+
+  fileStat.m_device = info.dwVolumeSerialNumber;
+  fileStat.m_inode = (static_cast<quint64>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+  fileStat.m_size = static_cast<qint64>((static_cast<quint64>(info.nFileSizeHigh) << 32) | info.nFileSizeLow);
+  fileStat.m_modifiedTime = FileTimeToNanoseconds(info.ftLastWriteTime);
+  fileStat.m_changedTime = fileStat.m_modifiedTime;
+  fileStat.m_createdTime = FileTimeToNanoseconds(info.ftCreationTime);
+  fileStat.m_linkCount = info.nNumberOfLinks;
+  fileStat.m_isDir = (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+  struct stat st;
+  if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+    return false;
+
+  FillFileStat(st, fileStat);
+#endif
+
+  return true;
+}
+
+#ifndef Q_OS_WIN
+
+struct DirLister::Impl
+{
+  DIR * m_dir = nullptr;
+  std::vector<QChar> m_name;
+};
+
+DirLister::DirLister(QString const & path)
+  : m_impl(new Impl())
+{
+  m_impl->m_dir = ::opendir(QFile::encodeName(path).constData());
+}
+
+DirLister::~DirLister()
+{
+  if (m_impl->m_dir != nullptr)
+    ::closedir(m_impl->m_dir);
+}
+
+bool DirLister::IsOpen() const
+{
+  return m_impl->m_dir != nullptr;
+}
+
+bool DirLister::Next(ListedEntry & entry)
+{
+  if (m_impl->m_dir == nullptr)
+    return false;
+
+  int const dirFd = ::dirfd(m_impl->m_dir);
+  while (dirent * dirEntry = ::readdir(m_impl->m_dir))
+  {
+    char const * name = dirEntry->d_name;
+    if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+      continue;
+
+    // an entry removed since the directory was read is left out
+    struct stat st;
+    if (::fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+      continue;
+
+    entry.m_isSymLink = S_ISLNK(st.st_mode);
+    entry.m_isDangling = false;
+    if (entry.m_isSymLink)
+    {
+      struct stat target;
+      if (::fstatat(dirFd, name, &target, 0) == 0)
+        st = target;
+      else
+        entry.m_isDangling = true;
+    }
+
+    FillFileStat(st, entry.m_stat);
+    entry.m_isHidden = name[0] == '.';
+    DecodeName(name, m_impl->m_name);
+    entry.m_name = m_impl->m_name.data();
+    entry.m_nameLength = static_cast<int>(m_impl->m_name.size());
+    return true;
+  }
+
+  return false;
+}
+
+#else
+
+struct DirLister::Impl
+{
+  explicit Impl(QString const & path)
+    : m_iterator(path, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot)
+    , m_isOpen(QFileInfo(path).isReadable())
+  {
+  }
+
+  QDirIterator m_iterator;
+  bool m_isOpen;
+  QString m_name;
+};
+
+DirLister::DirLister(QString const & path)
+  : m_impl(new Impl(path))
+{
+}
+
+DirLister::~DirLister()
+{
+}
+
+bool DirLister::IsOpen() const
+{
+  return m_impl->m_isOpen;
+}
+
+bool DirLister::Next(ListedEntry & entry)
+{
+  if (!m_impl->m_iterator.hasNext())
+    return false;
+
+  m_impl->m_iterator.next();
+  QFileInfo const info = m_impl->m_iterator.fileInfo();
+  m_impl->m_name = m_impl->m_iterator.fileName();
+  entry.m_name = m_impl->m_name.constData();
+  entry.m_nameLength = m_impl->m_name.size();
+  entry.m_isSymLink = info.isSymLink();
+  entry.m_isDangling = entry.m_isSymLink && !info.exists();
+  entry.m_isHidden = info.isHidden();
+
+  FileStat & stat = entry.m_stat;
+  stat = FileStat();
+  stat.m_size = info.size();
+  stat.m_modifiedTime = info.lastModified().toMSecsSinceEpoch() * 1000000;
+  stat.m_changedTime = stat.m_modifiedTime;
+  stat.m_createdTime = info.created().toMSecsSinceEpoch() * 1000000;
+  stat.m_linkCount = 1;
+  stat.m_permissions = static_cast<quint16>(info.permissions());
+  stat.m_ownerId = info.ownerId();
+  stat.m_isDir = info.isDir();
+  return true;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QMetaType>
+#include <QString>
+
+#include <memory>
+
+/// Identity and change stamps of a file system entry, read with a single stat call
+struct FileStat
+{
+  quint64 m_device = 0;
+  quint64 m_inode = 0;
+  qint64 m_size = 0;
+  /// nanoseconds since epoch where the platform provides them
+  qint64 m_modifiedTime = 0;
+  qint64 m_changedTime = 0;
+  /// the status change time on Unix, as QFileInfo::created reports it there
+  qint64 m_createdTime = 0;
+  quint32 m_linkCount = 0;
+  /// QFile::Permissions bits
+  quint16 m_permissions = 0;
+  uint m_ownerId = 0;
+  bool m_isDir = false;
+};
+
+Q_DECLARE_METATYPE(FileStat)
+
+bool operator == (FileStat const & l, FileStat const & r);
+bool operator != (FileStat const & l, FileStat const & r);
+
+bool ReadFileStat(QString const & path, FileStat & fileStat);
+
+/// Entry of a DirLister, the name is valid until the next entry is read
+struct ListedEntry
+{
+  QChar const * m_name = nullptr;
+  int m_nameLength = 0;
+  /// of the target for symbolic links, of the link itself when the target is missing
+  FileStat m_stat;
+  bool m_isSymLink = false;
+  bool m_isDangling = false;
+  /// the name starts with a dot on Unix
+  bool m_isHidden = false;
+};
+
+/// Reads a directory with one stat call per entry and no string per entry, symbolic links take
+/// a second call for their target. Without Unix the entries come from QDirIterator, their device
+/// and inode are 0, so hard links are not recognized there.
+class DirLister
+{
+public:
+  explicit DirLister(QString const & path);
+  ~DirLister();
+
+  /// false when the directory cannot be read
+  bool IsOpen() const;
+  /// "." and ".." are skipped, false after the last entry
+  bool Next(ListedEntry & entry);
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+};
@@ -1,15 +1,41 @@
 #include "file_system_model.hpp"
 #include "macros.hpp"
+#include "archive_scaner.hpp"
 #include "dir_scaner.hpp"
-
+#include "refresh_scaner.hpp"
+#include "chunked_vector.hpp"
+#include "entry_info.hpp"
+#include "exporter.hpp"
+#include "name_matcher.hpp"
+#include "parallel_crawler.hpp"
+#include "snapshot.hpp"
+#include "type_detector.hpp"
+
+#include <QDir>
 #include <QFileInfo>
 #include <QIcon>
+#include <QMimeDatabase>
 #include <QDateTime>
+#include <QSet>
 #include <QThreadPool>
+#include <QTimer>
+
+#include <algorithm>
+#include <memory>
+#include <set>
 
 namespace
 {
 
+/// Rows of a directory are shown to views by pages, the next page is exposed by fetchMore
+size_t const PageSize = 2048;
+
+/// Directories stat'ed by one RefreshScaner, small enough for the scheduler to spread them
+size_t const RefreshBatchSize = 256;
+
+/// Files handed to one TypeDetector, a sort by the Type column asks for a whole directory at once
+size_t const TypeBatchSize = 256;
+
 template <typename T, typename ...Args>
 std::unique_ptr<T> MakeUnique(Args &&... args)
 {
@@ -19,14 +45,15 @@ std::unique_ptr<T> MakeUnique(Args &&... args)
 class Node
 {
 public:
-  Node(QFileInfo const & info)
+  Node(EntryInfo const & info)
     : m_info(info)
   {
   }
 
-  void AddChild(QFileInfo const & info)
+  /// New child is not visible to views until it is exposed
+  void AddChild(EntryInfo const & info)
   {
-    m_children.emplace_back(new Node(info, this, m_children.size()));
+    m_children.push_back(std::unique_ptr<Node>(new Node(info, this, m_children.size())));
     if (m_checkState != Qt::Unchecked)
       m_children.back()->SetCheckState(Qt::Checked);
   }
@@ -36,11 +63,21 @@ public:
     return m_parent;
   }
 
-  QFileInfo const & GetInfo() const
+  EntryInfo const & GetInfo() const
   {
     return m_info;
   }
 
+  NameRef GetName() const
+  {
+    return m_info.m_name;
+  }
+
+  void SetInfo(EntryInfo const & info)
+  {
+    m_info = info;
+  }
+
   size_t GetChildCount() const
   {
     return m_children.size();
@@ -58,6 +95,76 @@ public:
     return m_children.back().get();
   }
 
+  /// Takes in a top level node that was scanned on its own, info comes from the listing of this node
+  void AdoptChild(std::unique_ptr<Node> && child, EntryInfo const & info)
+  {
+    child->m_info = info;
+    child->m_parent = this;
+    child->m_childIndex = static_cast<int>(m_children.size());
+    if (m_checkState != Qt::Unchecked)
+      child->SetSubtreeCheckState(Qt::Checked);
+    m_children.push_back(std::move(child));
+  }
+
+  /// Detaches a child with its subtree, it becomes a top level node
+  std::unique_ptr<Node> TakeChild(size_t index)
+  {
+    std::unique_ptr<Node> child = std::move(m_children[index]);
+    RemoveChildren(index, index);
+    child->m_parent = nullptr;
+    return child;
+  }
+
+  /// Removes children in [first, last] range and renumbers the ones after them
+  void RemoveChildren(size_t first, size_t last)
+  {
+    Q_ASSERT(first <= last && last < m_children.size());
+    if (first < m_exposedCount)
+      m_exposedCount -= std::min(last + 1, m_exposedCount) - first;
+
+    m_children.erase(first, last + 1);
+    for (size_t i = first; i < m_children.size(); ++i)
+      m_children[i]->m_childIndex = static_cast<int>(i);
+
+    m_nameIndex.clear();
+  }
+
+  /// Binary search over the name index, nullptr when there is no such child.
+  /// TName is a QString or a NameRef of the same pool.
+  template <typename TName>
+  Node * FindChild(NamePool const & pool, TName const & name)
+  {
+    UpdateNameIndex(pool);
+    std::vector<quint32>::const_iterator it =
+        std::lower_bound(m_nameIndex.begin(), m_nameIndex.end(), name, [this, &pool](quint32 index, TName const & key)
+    {
+      return pool.Compare(m_children[index]->GetName(), key) < 0;
+    });
+
+    if (it == m_nameIndex.end() || pool.Compare(m_children[*it]->GetName(), name) != 0)
+      return nullptr;
+
+    return m_children[*it].get();
+  }
+
+  /// Children that views know about, always a prefix of all children
+  size_t GetExposedCount() const
+  {
+    return m_exposedCount;
+  }
+
+  void SetExposedCount(size_t count)
+  {
+    Q_ASSERT(count <= m_children.size());
+    m_exposedCount = count;
+  }
+
+  /// How many children may be exposed without an explicit fetchMore
+  size_t GetPageLimit() const
+  {
+    return std::max(PageSize, (m_exposedCount + PageSize - 1) / PageSize * PageSize);
+  }
+
   Qt::CheckState GetCheckState() const
   {
     return m_checkState;
@@ -73,6 +180,13 @@ public:
     return m_childIndex;
   }
 
+  /// Top level nodes are numbered by the model
+  void SetChildIndex(int childIndex)
+  {
+    Q_ASSERT(m_parent == nullptr);
+    m_childIndex = childIndex;
+  }
+
   enum EScanStatus
   {
     NotScaned,
@@ -80,6 +194,13 @@ public:
     Finished
   };
 
+  /// What is left of the subtree after it was evicted
+  struct Summary
+  {
+    quint64 m_count = 0;
+    qint64 m_size = 0;
+  };
+
   EScanStatus GetStatus() const
   {
     return m_status;
@@ -90,27 +211,314 @@ public:
     m_status = status;
   }
 
+  quint32 GetLastAccess() const
+  {
+    return m_lastAccess;
+  }
+
+  void Touch(quint32 tick)
+  {
+    m_lastAccess = tick;
+  }
+
+  /// Expanded in the tree or shown as table root, counted because both views may hold it
+  bool IsExpanded() const
+  {
+    return m_expandCount > 0;
+  }
+
+  void SetExpanded(bool expanded)
+  {
+    if (expanded)
+      ++m_expandCount;
+    else if (m_expandCount > 0)
+      --m_expandCount;
+  }
+
+  void ResetExpanded()
+  {
+    m_expandCount = 0;
+    for (size_t i = 0; i < m_children.size(); ++i)
+      m_children[i]->ResetExpanded();
+  }
+
+  Summary const & GetSummary() const
+  {
+    return m_summary;
+  }
+
+  void ResetSummary()
+  {
+    m_summary = Summary();
+  }
+
+  void Evict()
+  {
+    Q_ASSERT(m_status == Finished);
+    m_summary = Summarize();
+    m_children.clear();
+    m_nameIndex.clear();
+    m_exposedCount = 0;
+    m_dirStat.reset();
+    m_status = NotScaned;
+  }
+
+  /// Stamps of the directory taken when its listing was read
+  FileStat const * GetDirStat() const
+  {
+    return m_dirStat.get();
+  }
+
+  void SetDirStat(FileStat const & stat)
+  {
+    m_dirStat = MakeUnique<FileStat>(stat);
+  }
+
+  /// UnknownType until a view asks for the type, PendingType while it is detected
+  quint16 GetTypeId() const
+  {
+    return m_typeId;
+  }
+
+  void SetTypeId(quint16 typeId)
+  {
+    m_typeId = typeId;
+  }
+
 private:
-  Node(QFileInfo const & info, Node * parent, int childIndex)
+  /// Children arrive in readdir order, the index keeps their positions sorted by name.
+  /// Entries added since the last lookup are sorted and merged in, so a lookup stays O(log n).
+  void UpdateNameIndex(NamePool const & pool)
+  {
+    size_t const indexedCount = m_nameIndex.size();
+    if (indexedCount == m_children.size())
+      return;
+
+    m_nameIndex.reserve(m_children.size());
+    for (size_t i = indexedCount; i < m_children.size(); ++i)
+      m_nameIndex.push_back(static_cast<quint32>(i));
+
+    auto nameLess = [this, &pool](quint32 l, quint32 r)
+    {
+      return pool.Compare(m_children[l]->GetName(), m_children[r]->GetName()) < 0;
+    };
+
+    std::vector<quint32>::iterator middle = m_nameIndex.begin() + indexedCount;
+    std::sort(middle, m_nameIndex.end(), nameLess);
+    std::inplace_merge(m_nameIndex.begin(), middle, m_nameIndex.end(), nameLess);
+  }
+
+  void SetSubtreeCheckState(Qt::CheckState state)
+  {
+    m_checkState = state;
+    for (size_t i = 0; i < m_children.size(); ++i)
+      m_children[i]->SetSubtreeCheckState(state);
+  }
+
+  Summary Summarize() const
+  {
+    if (m_children.empty())
+      return m_summary;
+
+    Summary summary;
+    for (size_t i = 0; i < m_children.size(); ++i)
+    {
+      Node const * child = m_children[i].get();
+      ++summary.m_count;
+      // an archive counts with its own file size, its members are not on disk
+      if (child->GetInfo().IsDir())
+      {
+        Summary childSummary = child->Summarize();
+        summary.m_count += childSummary.m_count;
+        summary.m_size += childSummary.m_size;
+      }
+      else
+        summary.m_size += child->GetInfo().m_size;
+    }
+
+    return summary;
+  }
+
+  Node(EntryInfo const & info, Node * parent, int childIndex)
     : m_info(info)
     , m_parent(parent)
     , m_childIndex(childIndex)
   {
   }
 
-  QFileInfo m_info;
+  EntryInfo m_info;
   Qt::CheckState m_checkState = Qt::Unchecked;
 
   Node * m_parent = nullptr;
   int m_childIndex = 0;
   EScanStatus m_status = NotScaned;
+  quint32 m_lastAccess = 0;
+  quint16 m_expandCount = 0;
+  quint16 m_typeId = UnknownType;
+  Summary m_summary;
+  std::unique_ptr<FileStat> m_dirStat;
+
+  ChunkedVector<std::unique_ptr<Node> > m_children;
+  std::vector<quint32> m_nameIndex;
+  size_t m_exposedCount = 0;
+};
 
-  std::vector<std::unique_ptr<Node> > m_children;
+/// Rough per node cost: Node itself and its slots in the parent's children and name index.
+/// Names are counted by the pool, they are shared between nodes.
+qint64 const NodeMemoryCost = sizeof(Node) + sizeof(std::unique_ptr<Node>) + sizeof(quint32);
+
+/// Values computed off the GUI thread, the first lookup for a node starts computing them
+class LazyFields
+{
+public:
+  /// Empty until the hash is known
+  virtual QByteArray GetHash(Node const * node) = 0;
+  /// PendingType until the type is known
+  virtual quint16 GetTypeId(Node const * node) = 0;
+  /// Made once per type, fallback when the platform has no icon for it
+  virtual QIcon GetTypeIcon(quint16 typeId, QIcon const & fallback) = 0;
+
+protected:
+  ~LazyFields()
+  {
+  }
+};
+
+/// What field getters may look at besides the node
+struct FieldContext
+{
+  NamePool const & m_pool;
+  LazyFields & m_lazy;
+  QHash<Node const *, QString> const & m_scanErrors;
+};
+
+void CollectScanedDirs(Node * node, std::vector<Node *> & dirs)
+{
+  if (node->GetStatus() != Node::Finished || node->GetDirStat() == nullptr)
+    return;
+
+  dirs.push_back(node);
+  for (size_t i = 0; i < node->GetChildCount(); ++i)
+    CollectScanedDirs(node->GetChild(i), dirs);
+}
+
+/// Topmost fully checked nodes, a checked directory stands for its whole subtree
+void CollectCheckedRoots(Node const * node, std::vector<Node const *> & roots)
+{
+  // members of an archive cannot be copied or deleted one by one
+  if (node->GetInfo().IsVirtual())
+    return;
+
+  if (node->GetCheckState() == Qt::Checked)
+  {
+    roots.push_back(node);
+    return;
+  }
+
+  if (node->GetCheckState() == Qt::PartiallyChecked)
+  {
+    for (size_t i = 0; i < node->GetChildCount(); ++i)
+      CollectCheckedRoots(node->GetChild(i), roots);
+  }
+}
+
+/// Pre-order walk over checked and partially checked nodes. Unchecked subtrees are skipped,
+/// fully checked directories that are not scanned completely are left to the exporter.
+void CollectChecked(Node const * node, quint32 depth, std::vector<ExportEntry> & entries,
+                    std::vector<Node const *> & expanded)
+{
+  if (node->GetCheckState() == Qt::Unchecked)
+    return;
+
+  ExportEntry entry;
+  entry.m_info = node->GetInfo();
+  entry.m_depth = depth;
+  entry.m_checked = node->GetCheckState() == Qt::Checked;
+  entry.m_expand = entry.m_checked && node->GetInfo().IsDir() && !node->GetInfo().IsVirtual() &&
+                   node->GetStatus() != Node::Finished;
+  entries.push_back(entry);
+
+  if (entry.m_expand)
+  {
+    expanded.push_back(node);
+    return;
+  }
+
+  for (size_t i = 0; i < node->GetChildCount(); ++i)
+    CollectChecked(node->GetChild(i), depth + 1, entries, expanded);
+}
+
+struct EvictionCandidate
+{
+  Node * m_node;
+  quint32 m_lastAccess;
+  quint64 m_nodeCount;
+};
+
+/// Post-order walk. Returns true when the whole subtree of node can be dropped:
+/// it is scanned, collapsed and unchecked, and so is everything below it.
+/// The topmost droppable directories are collected as candidates.
+bool CollectEvictionCandidates(Node * node, std::vector<EvictionCandidate> & candidates,
+                               quint32 & lastAccess, quint64 & nodeCount)
+{
+  lastAccess = node->GetLastAccess();
+  nodeCount = 0;
+
+  bool canEvict = node->GetParent() != nullptr &&
+                  node->GetStatus() != Node::Running &&
+                  node->GetCheckState() == Qt::Unchecked &&
+                  !node->IsExpanded();
+
+  std::vector<EvictionCandidate> childCandidates;
+  for (size_t i = 0; i < node->GetChildCount(); ++i)
+  {
+    Node * child = node->GetChild(i);
+    quint32 childAccess = 0;
+    quint64 childCount = 0;
+    bool canEvictChild = CollectEvictionCandidates(child, candidates, childAccess, childCount);
+
+    lastAccess = std::max(lastAccess, childAccess);
+    nodeCount += childCount + 1;
+    canEvict = canEvict && canEvictChild;
+
+    if (canEvictChild && childCount > 0)
+      childCandidates.push_back(EvictionCandidate{ child, childAccess, childCount });
+  }
+
+  if (!canEvict)
+    candidates.insert(candidates.end(), childCandidates.begin(), childCandidates.end());
+
+  return canEvict;
+}
+
+/// Top level node of the forest and what its subtree is scanned with
+struct Root
+{
+  std::unique_ptr<Node> m_node;
+  /// Absolute path, paths of the nodes below are rebuilt from their names
+  QString m_path;
+  quint64 m_device = 0;
+  TIgnoreRules m_rules;
 };
 
+QString CleanPath(QString const & path)
+{
+  return QDir::cleanPath(QFileInfo(QDir::fromNativeSeparators(path)).absoluteFilePath());
+}
+
+/// Both paths are clean and absolute, a path is inside itself
+bool IsInside(QString const & path, QString const & dirPath)
+{
+  if (!path.startsWith(dirPath))
+    return false;
+
+  // the root of a drive already ends with a separator
+  return path.size() == dirPath.size() || dirPath.endsWith('/') || path[dirPath.size()] == '/';
+}
+
 } // namespace
 
-struct FileSystemModel::Impl
+struct FileSystemModel::Impl : public LazyFields
 {
   Impl(FileSystemModel * model)
     : m_model(model)
@@ -118,26 +526,296 @@ struct FileSystemModel::Impl
   }
 
   FileSystemModel * m_model;
-  std::unique_ptr<Node> m_root;
+  /// Top level rows, their paths never overlap: a root inside another one is a node of it
+  std::vector<Root> m_roots;
+  /// Former top level roots a newly added root contains. They keep their nodes and are
+  /// grafted in when the listing of their parent arrives.
+  std::vector<Root> m_detached;
+  /// Every added root, nested ones included
+  QStringList m_rootPaths;
+  /// Exclusion rules each root was added with
+  QHash<QString, QStringList> m_rootLines;
+
+  struct PendingPath
+  {
+    QString m_path;
+    /// empty for detached roots, they are grafted by entriesFounded
+    function<void (QModelIndex const &)> m_loaded;
+  };
+
+  /// Paths being loaded directory by directory
+  std::vector<PendingPath> m_pendingPaths;
+  /// Shared with running scaners, they intern names on the pool threads
+  std::shared_ptr<NamePool> m_pool = std::make_shared<NamePool>();
+  /// names freed by a removal or an eviction are compacted once no scaner runs
+  bool m_isCompactPending = false;
+  /// entries refused by pools that were replaced since clearRoots
+  quint64 m_failedNames = 0;
+  ScanScheduler m_scheduler;
+
+  QStringList m_ignoreLines;
+  bool m_readGitIgnore = false;
+  /// Directories with a .gitignore file, their rules include the ones of every directory above
+  QHash<Node const *, TIgnoreRules> m_dirRules;
+  PruneCount m_pruneCount;
+  /// Archives that could not be read, the error is shown in their tooltip
+  QHash<Node const *, QString> m_scanErrors;
+
+  HashService m_hashService;
+  /// Hashes of files shown in the Hash column, an empty one means the file could not be read
+  QHash<Node const *, QByteArray> m_hashes;
+  /// Requested hashes, true for the ones the service keeps until they are done
+  QHash<Node const *, bool> m_hashPending;
+
+  /// Files waiting for the next detector batch
+  std::vector<TypeRequest> m_typeRequests;
+  bool m_typeScheduled = false;
+  /// Indexed by type id, null until a row of the type is painted
+  std::vector<QIcon> m_typeIcons;
+
+  quint64 m_nodeCount = 0;
+  quint32 m_tick = 0;
+  qint64 m_memoryBudget = 0;
+  qint64 m_evictionThreshold = 0;
+  bool m_evictionScheduled = false;
+
+  void Touch(Node * node)
+  {
+    node->Touch(++m_tick);
+  }
+
+  /// Root the node belongs to, attached or waiting to be grafted, nullptr for a node of no root
+  Root const * FindRoot(Node const * node) const
+  {
+    Node const * top = node;
+    while (top->GetParent() != nullptr)
+      top = top->GetParent();
+
+    for (std::vector<Root> const * roots : { &m_roots, &m_detached })
+    {
+      for (Root const & root : *roots)
+      {
+        if (root.m_node.get() == top)
+          return &root;
+      }
+    }
+
+    Q_ASSERT(false);
+    return nullptr;
+  }
+
+  /// Top level root that contains the clean path, nullptr when there is none
+  Root * FindContainingRoot(QString const & cleanPath)
+  {
+    for (Root & root : m_roots)
+    {
+      if (IsInside(cleanPath, root.m_path))
+        return &root;
+    }
+
+    return nullptr;
+  }
+
+  /// Nodes keep only their names, the path is joined on demand by walking to the root
+  QString BuildPath(Node const * node) const
+  {
+    Root const * root = FindRoot(node);
+    if (root == nullptr)
+      return QString();
+
+    QString const & rootPath = root->m_path;
+    if (node->GetParent() == nullptr)
+      return rootPath;
+
+    // the root of a drive already ends with a separator
+    int const rootLength = rootPath.endsWith('/') ? rootPath.size() - 1 : rootPath.size();
+    int length = rootLength;
+    for (Node const * n = node; n->GetParent() != nullptr; n = n->GetParent())
+      length += n->GetName().m_length + 1;
+
+    QString path(length, Qt::Uninitialized);
+    QChar * data = path.data();
+    std::copy(rootPath.constBegin(), rootPath.constBegin() + rootLength, data);
+    for (Node const * n = node; n->GetParent() != nullptr; n = n->GetParent())
+    {
+      NameRef const name = n->GetName();
+      length -= name.m_length;
+      std::copy(m_pool->Data(name), m_pool->Data(name) + name.m_length, data + length);
+      data[--length] = QLatin1Char('/');
+    }
+
+    return path;
+  }
+
+  /// Device of a directory without a stat call on the GUI thread: the one its parent lives on.
+  /// A mount point is attributed to the device it is mounted on until its own listing is read,
+  /// archive members to the device of the archive.
+  quint64 GetDevice(Node const * node) const
+  {
+    for (Node const * n = node; n != nullptr; n = n->GetParent())
+    {
+      if (n->GetDirStat() != nullptr)
+        return n->GetDirStat()->m_device;
+    }
+
+    Root const * root = FindRoot(node);
+    return root != nullptr ? root->m_device : 0;
+  }
+
+  /// The archive node holds the path on disk, members below it only names inside the archive
+  Node const * FindArchive(Node const * node) const
+  {
+    Node const * archive = node;
+    while (archive->GetInfo().IsVirtual() && archive->GetParent() != nullptr)
+      archive = archive->GetParent();
+
+    return archive->GetInfo().IsArchive() ? archive : nullptr;
+  }
+
+  QByteArray GetHash(Node const * node) override
+  {
+    QHash<Node const *, QByteArray>::const_iterator it = m_hashes.constFind(node);
+    if (it != m_hashes.constEnd())
+      return it.value();
+
+    RequestHash(node, false);
+    return QByteArray();
+  }
+
+  /// Painted rows ask with isKept false, their requests are dropped once they are stale
+  void RequestHash(Node const * node, bool isKept)
+  {
+    QHash<Node const *, bool>::iterator pending = m_hashPending.find(node);
+    if (pending == m_hashPending.end())
+    {
+      m_hashPending.insert(node, isKept);
+      m_hashService.request(BuildPath(node), isKept);
+    }
+    else if (isKept && !pending.value())
+    {
+      // the painted request may still be dropped, the kept one is not
+      pending.value() = true;
+      m_hashService.request(BuildPath(node), true);
+    }
+  }
+
+  quint16 GetTypeId(Node const * node) override
+  {
+    if (node->GetTypeId() != UnknownType)
+      return node->GetTypeId();
+
+    // the model owns every node, views only hold const pointers to paint them
+    const_cast<Node *>(node)->SetTypeId(PendingType);
+    TypeRequest request;
+    request.m_path = BuildPath(node);
+    request.m_canRead = !node->GetInfo().IsVirtual();
+    m_typeRequests.push_back(request);
+    ScheduleTypeDetection();
+    return PendingType;
+  }
+
+  QIcon GetTypeIcon(quint16 typeId, QIcon const & fallback) override
+  {
+    if (typeId >= m_typeIcons.size())
+      m_typeIcons.resize(typeId + 1);
+
+    QIcon & icon = m_typeIcons[typeId];
+    if (icon.isNull())
+    {
+      QMimeType const type = QMimeDatabase().mimeTypeForName(GetTypeName(typeId));
+      icon = QIcon::fromTheme(type.iconName(), QIcon::fromTheme(type.genericIconName(), fallback));
+    }
+
+    return icon;
+  }
+
+  /// Rows painted in one event loop pass are detected together
+  void ScheduleTypeDetection()
+  {
+    if (m_typeScheduled)
+      return;
+
+    m_typeScheduled = true;
+    QTimer::singleShot(0, m_model, [this]()
+    {
+      m_typeScheduled = false;
+      for (size_t first = 0; first < m_typeRequests.size(); first += TypeBatchSize)
+      {
+        size_t const last = std::min(first + TypeBatchSize, m_typeRequests.size());
+        std::vector<TypeRequest> requests(std::make_move_iterator(m_typeRequests.begin() + first),
+                                          std::make_move_iterator(m_typeRequests.begin() + last));
+        TypeDetector * detector = new TypeDetector(std::move(requests));
+        VERIFY(QObject::connect(detector, &TypeDetector::typesDetected,
+                                m_model, &FileSystemModel::typesDetected, Qt::QueuedConnection));
+        detector->setAutoDelete(false);
+        QThreadPool::globalInstance()->start(detector);
+      }
+
+      m_typeRequests.clear();
+    });
+  }
+
+  /// Rules that apply to the entries of node
+  TIgnoreRules FindRules(Node const * node) const
+  {
+    for (Node const * n = node; n != nullptr; n = n->GetParent())
+    {
+      QHash<Node const *, TIgnoreRules>::const_iterator it = m_dirRules.constFind(n);
+      if (it != m_dirRules.constEnd())
+        return it.value();
+    }
+
+    Root const * root = FindRoot(node);
+    return root != nullptr ? root->m_rules : TIgnoreRules();
+  }
+
+  /// Path below the root the rules are matched against, "" for the root itself
+  QString BuildRelativePath(Node const * node) const
+  {
+    Root const * root = FindRoot(node);
+    if (node->GetParent() == nullptr || root == nullptr)
+      return QString();
+
+    QString const & rootPath = root->m_path;
+    int const rootLength = rootPath.endsWith('/') ? rootPath.size() - 1 : rootPath.size();
+    return BuildPath(node).mid(rootLength + 1);
+  }
 
   void RunScaner(Node * node)
   {
-    if (node->GetInfo().isDir())
+    if (node->GetInfo().IsContainer())
     {
       node->SetStatus(Node::Running);
-      DirScaner * scaner = CreateScaner(node->GetInfo());
+      node->ResetSummary();
+      // the .gitignore of the directory is read again by the scaner
+      m_dirRules.remove(node);
+      m_scanErrors.remove(node);
+      DirScaner * scaner = CreateScaner(node);
       m_scanerIndex.insert(std::make_pair(scaner, node));
-      QThreadPool::globalInstance()->start(scaner);
+      m_scheduler.start(scaner, GetDevice(node));
     }
     else
       node->SetStatus(Node::Finished);
   }
 
-  DirScaner * CreateScaner(QFileInfo const & info)
+  DirScaner * CreateScaner(Node const * node)
   {
-    DirScaner * scaner = new DirScaner(info.absoluteFilePath());
-    VERIFY(QObject::connect(scaner, &DirScaner::fileFounded,
-                            m_model, &FileSystemModel::fileFounded, Qt::QueuedConnection));
+    DirScaner * scaner = nullptr;
+    Node const * archive = FindArchive(node);
+    if (archive != nullptr)
+    {
+      QString const archivePath = BuildPath(archive);
+      scaner = new ArchiveScaner(archivePath, BuildPath(node).mid(archivePath.size() + 1), m_pool);
+    }
+    else
+      scaner = new DirScaner(BuildPath(node), BuildRelativePath(node), m_pool, FindRules(node), m_readGitIgnore);
+
+    VERIFY(QObject::connect(scaner, &DirScaner::rulesFounded,
+                            m_model, &FileSystemModel::rulesFounded, Qt::QueuedConnection));
+    VERIFY(QObject::connect(scaner, &DirScaner::entriesFounded,
+                            m_model, &FileSystemModel::entriesFounded, Qt::QueuedConnection));
+    VERIFY(QObject::connect(scaner, &DirScaner::scanFailed,
+                            m_model, &FileSystemModel::scanFailed, Qt::QueuedConnection));
     VERIFY(QObject::connect(scaner, &DirScaner::scanFinished,
                             m_model, &FileSystemModel::scanFinished, Qt::QueuedConnection));
     scaner->setAutoDelete(true);
@@ -145,44 +823,562 @@ struct FileSystemModel::Impl
     return scaner;
   }
 
+  /// Drops every trace of the subtree before its nodes are deleted
+  void ForgetSubtree(Node * node)
+  {
+    --m_nodeCount;
+    m_refreshNodes.remove(node);
+    m_unexposedNodes.remove(node);
+    m_dirRules.remove(node);
+    m_scanErrors.remove(node);
+    m_hashes.remove(node);
+    m_hashPending.remove(node);
+
+    if (node->GetStatus() == Node::Running)
+    {
+      for (TScanerIndex::iterator it = m_scanerIndex.begin(); it != m_scanerIndex.end(); ++it)
+      {
+        if (it->second == node)
+        {
+          it->first->cancel();
+          m_scanerIndex.erase(it);
+          break;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < node->GetChildCount(); ++i)
+      ForgetSubtree(node->GetChild(i));
+  }
+
+  /// Applies a fresh listing of a changed directory with as few row signals as possible
+  void MergeListing(Node * node, std::vector<EntryInfo> const & entries)
+  {
+    QModelIndex parentIndex = m_model->createIndex(node->GetChildIndex(), 0, node);
+
+    int const childCount = static_cast<int>(node->GetChildCount());
+    std::vector<bool> isKnownEntry(entries.size(), false);
+    std::vector<bool> isRemovedChild(childCount, true);
+    for (size_t entryIndex = 0; entryIndex < entries.size(); ++entryIndex)
+    {
+      EntryInfo const & fresh = entries[entryIndex];
+      Node * child = node->FindChild(*m_pool, fresh.m_name);
+      if (child == nullptr || child->GetInfo().IsDir() != fresh.IsDir())
+        continue;
+
+      int const i = child->GetChildIndex();
+      EntryInfo const & info = child->GetInfo();
+      isKnownEntry[entryIndex] = true;
+      isRemovedChild[i] = false;
+      if (fresh.m_size != info.m_size || fresh.m_modifiedTime != info.m_modifiedTime)
+      {
+        // listed members of a changed archive are stale, it is read again on the next expand
+        if (info.IsArchive() && child->GetStatus() == Node::Finished)
+        {
+          EvictNode(child);
+          child->ResetSummary();
+          m_scanErrors.remove(child);
+        }
+
+        child->SetInfo(fresh);
+        child->SetTypeId(UnknownType);
+        // a hash still running was taken of the old content, hashReady drops it
+        m_hashes.remove(child);
+        m_hashPending.remove(child);
+        if (i >= static_cast<int>(node->GetExposedCount()))
+          continue;
+
+        int const lastColumn = m_model->columnCount(parentIndex) - 1;
+        emit m_model->dataChanged(m_model->createIndex(i, 0, child), m_model->createIndex(i, lastColumn, child),
+                                  QVector<int>{ Qt::DisplayRole });
+      }
+    }
+
+    // contiguous runs from the back, so row numbers in front of a run stay valid
+    for (int last = childCount - 1; last >= 0; --last)
+    {
+      if (!isRemovedChild[last])
+        continue;
+
+      int first = last;
+      while (first > 0 && isRemovedChild[first - 1])
+        --first;
+
+      // only the exposed part of the run is known to views
+      int const exposedCount = static_cast<int>(node->GetExposedCount());
+      bool const isExposed = first < exposedCount;
+      if (isExposed)
+        m_model->beginRemoveRows(parentIndex, first, std::min(last, exposedCount - 1));
+
+      for (int i = first; i <= last; ++i)
+        ForgetSubtree(node->GetChild(i));
+      node->RemoveChildren(first, last);
+
+      if (isExposed)
+        m_model->endRemoveRows();
+
+      last = first;
+    }
+
+    int addedCount = static_cast<int>(std::count(isKnownEntry.begin(), isKnownEntry.end(), false));
+    if (addedCount == 0)
+      return;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+      if (!isKnownEntry[i])
+        node->AddChild(entries[i]);
+    }
+    ExposeRows(node, node->GetPageLimit());
+
+    m_nodeCount += addedCount;
+    m_model->scheduleEviction();
+  }
+
+  /// Drops the children of a scanned node back to not scanned state
+  void EvictNode(Node * node)
+  {
+    int const exposedCount = static_cast<int>(node->GetExposedCount());
+    if (exposedCount > 0)
+      m_model->beginRemoveRows(m_model->createIndex(node->GetChildIndex(), 0, node), 0, exposedCount - 1);
+
+    for (size_t i = 0; i < node->GetChildCount(); ++i)
+      ForgetSubtree(node->GetChild(i));
+    node->Evict();
+
+    if (exposedCount > 0)
+      m_model->endRemoveRows();
+  }
+
+  /// Resolves an absolute path to a loaded node, O(depth * log n).
+  /// With expose every node on the way is shown to views, so an index can be created for it.
+  Node * FindNode(QString const & path, bool expose)
+  {
+    QString const cleanPath = CleanPath(path);
+    Root * root = FindContainingRoot(cleanPath);
+    if (root == nullptr)
+      return nullptr;
+
+    if (cleanPath == root->m_path)
+      return root->m_node.get();
+
+    QString const prefix = root->m_path.endsWith('/') ? root->m_path : root->m_path + '/';
+    Node * node = root->m_node.get();
+    for (QString const & name : cleanPath.mid(prefix.size()).split('/', QString::SkipEmptyParts))
+    {
+      Node * child = node->FindChild(*m_pool, name);
+      if (child == nullptr)
+        return nullptr;
+
+      if (expose)
+        ExposeRows(node, child->GetChildIndex() + 1);
+      node = child;
+    }
+
+    return node;
+  }
+
+  CrawlRoot MakeCrawlRoot(Node const * node) const
+  {
+    CrawlRoot root;
+    // archive members are read from the archive, not from disk
+    if (!node->GetInfo().IsDir() || node->GetInfo().IsVirtual())
+      return root;
+
+    root.m_path = BuildPath(node);
+    root.m_relativePath = BuildRelativePath(node);
+    // the .gitignore of the directory itself is read by the crawler
+    Node const * parent = node->GetParent();
+    if (parent != nullptr)
+      root.m_rules = FindRules(parent);
+    else if (Root const * nodeRoot = FindRoot(node))
+      root.m_rules = nodeRoot->m_rules;
+    root.m_readGitIgnore = m_readGitIgnore;
+    return root;
+  }
+
+  TIgnoreRules MakeRootRules(QString const & cleanPath) const
+  {
+    QStringList const lines = m_rootLines.value(cleanPath);
+    if (lines.isEmpty())
+      return TIgnoreRules();
+
+    return std::make_shared<IgnoreRules>(nullptr, QString(), lines);
+  }
+
+  /// Root node for a clean path of an existing entry, it is not scanned yet
+  Root MakeRoot(QString const & cleanPath)
+  {
+    QFileInfo const info(cleanPath);
+    Root root;
+    root.m_path = cleanPath;
+    root.m_rules = MakeRootRules(cleanPath);
+    FileStat stat;
+    if (ReadFileStat(cleanPath, stat))
+      root.m_device = stat.m_device;
+    // the root shows the whole path only when it is a drive root
+    QString const name = info.isRoot() ? info.absolutePath() : info.fileName();
+    EntryInfo entry;
+    // with a full pool the row stays without a name, the scan diagnostics tell why
+    if (!MakeEntryInfo(info, name, *m_pool, entry))
+      entry = MakeEntryInfo(info);
+    root.m_node.reset(new Node(entry));
+    ++m_nodeCount;
+    return root;
+  }
+
+  /// Moves the names of the remaining nodes into a fresh pool, the names of removed and
+  /// evicted nodes go with the old one. Batches of running scaners refer to the current pool,
+  /// so the move waits until they are done. Snapshots keep the old pool alive as long as they need it.
+  void CompactPool()
+  {
+    if (!m_scanerIndex.empty() || !m_refreshScaners.empty())
+    {
+      m_isCompactPending = true;
+      return;
+    }
+
+    m_isCompactPending = false;
+    std::shared_ptr<NamePool> pool = std::make_shared<NamePool>();
+    std::vector<Node *> stack;
+    for (std::vector<Root> const * roots : { &m_roots, &m_detached })
+    {
+      for (Root const & root : *roots)
+        stack.push_back(root.m_node.get());
+    }
+
+    while (!stack.empty())
+    {
+      Node * node = stack.back();
+      stack.pop_back();
+      // the fresh pool holds fewer names than the old one, so it is never full
+      EntryInfo info = node->GetInfo();
+      pool->Intern(m_pool->Data(info.m_name), info.m_name.m_length, info.m_name);
+      node->SetInfo(info);
+      for (size_t i = 0; i < node->GetChildCount(); ++i)
+        stack.push_back(node->GetChild(i));
+    }
+
+    m_failedNames += m_pool->GetFailedCount();
+    m_pool = pool;
+
+    // the budget check waits for a usage that is lower now
+    if (m_memoryBudget > 0)
+      m_evictionThreshold = std::min(m_evictionThreshold,
+                                     std::max(m_memoryBudget, m_model->memoryUsage() + m_memoryBudget / 8));
+  }
+
+  /// Appends top level rows, the ones that were never listed are scanned
+  void InsertRoots(std::vector<Root> && roots)
+  {
+    if (roots.empty())
+      return;
+
+    int const first = static_cast<int>(m_roots.size());
+    m_model->beginInsertRows(QModelIndex(), first, first + static_cast<int>(roots.size()) - 1);
+    for (Root & root : roots)
+    {
+      root.m_node->SetChildIndex(static_cast<int>(m_roots.size()));
+      m_roots.push_back(std::move(root));
+    }
+    m_model->endInsertRows();
+
+    for (size_t i = first; i < m_roots.size(); ++i)
+    {
+      if (m_roots[i].m_node->GetStatus() == Node::NotScaned)
+        RunScaner(m_roots[i].m_node.get());
+    }
+  }
+
+  void RenumberRoots()
+  {
+    for (size_t i = 0; i < m_roots.size(); ++i)
+      m_roots[i].m_node->SetChildIndex(static_cast<int>(i));
+  }
+
+  /// Moves a top level row to the detached roots, its nodes are kept
+  void DetachRoot(size_t row)
+  {
+    m_model->beginRemoveRows(QModelIndex(), static_cast<int>(row), static_cast<int>(row));
+    // views drop the expanded state of removed rows without a collapse
+    m_roots[row].m_node->ResetExpanded();
+    m_detached.push_back(std::move(m_roots[row]));
+    m_roots.erase(m_roots.begin() + row);
+    RenumberRoots();
+    m_model->endRemoveRows();
+  }
+
+  /// Subtree changes its root, rules read from its .gitignore files are relative to the old one
+  void ForgetRules(Node const * node)
+  {
+    m_dirRules.remove(node);
+    for (size_t i = 0; i < node->GetChildCount(); ++i)
+      ForgetRules(node->GetChild(i));
+  }
+
+  /// A detached root listed in the directory at dirPath takes the place of a fresh node,
+  /// so its subtree is not scanned again. False when entry is not a detached root.
+  bool GraftDetached(Node * node, QString const & dirPath, EntryInfo const & entry)
+  {
+    QString const path = (dirPath.endsWith('/') ? dirPath : dirPath + '/') + m_pool->Get(entry.m_name);
+    for (std::vector<Root>::iterator it = m_detached.begin(); it != m_detached.end(); ++it)
+    {
+      if (it->m_path != path)
+        continue;
+
+      ForgetRules(it->m_node.get());
+      node->AdoptChild(std::move(it->m_node), entry);
+      m_detached.erase(it);
+      return true;
+    }
+
+    return false;
+  }
+
+  /// Detached roots wait for the directories down to them to be listed, the ones no root
+  /// contains any more are dropped
+  void LoadDetached()
+  {
+    for (size_t i = m_detached.size(); i-- > 0;)
+    {
+      QString const path = m_detached[i].m_path;
+      if (FindContainingRoot(path) == nullptr)
+        DropDetached(path);
+      else if (std::none_of(m_pendingPaths.begin(), m_pendingPaths.end(),
+                            [&path](PendingPath const & pending) { return pending.m_path == path; }))
+        m_pendingPaths.push_back(PendingPath{ path, nullptr });
+    }
+
+    LoadPending();
+  }
+
+  void DropDetached(QString const & cleanPath)
+  {
+    for (std::vector<Root>::iterator it = m_detached.begin(); it != m_detached.end(); ++it)
+    {
+      if (it->m_path == cleanPath)
+      {
+        ForgetSubtree(it->m_node.get());
+        m_detached.erase(it);
+        return;
+      }
+    }
+  }
+
+  enum ELoadState
+  {
+    Loaded,
+    Loading,
+    Missing
+  };
+
+  /// Lists the directories on the way to the clean path, one listing per call.
+  /// Only the directory that lacks the next name is scanned, nothing else is expanded.
+  ELoadState LoadPath(QString const & cleanPath)
+  {
+    Root * root = FindContainingRoot(cleanPath);
+    if (root == nullptr)
+      return Missing;
+
+    QString const prefix = root->m_path.endsWith('/') ? root->m_path : root->m_path + '/';
+    Node * node = root->m_node.get();
+    for (QString const & name : cleanPath.mid(prefix.size()).split('/', QString::SkipEmptyParts))
+    {
+      Node * child = node->FindChild(*m_pool, name);
+      if (child == nullptr)
+      {
+        if (node->GetStatus() == Node::NotScaned)
+          RunScaner(node);
+
+        return node->GetStatus() == Node::Running ? Loading : Missing;
+      }
+
+      node = child;
+    }
+
+    return Loaded;
+  }
+
+  /// Called whenever a listing is finished, paths that are loaded or gone are done
+  void LoadPending()
+  {
+    std::vector<PendingPath> pending;
+    pending.swap(m_pendingPaths);
+    for (PendingPath & path : pending)
+    {
+      switch (LoadPath(path.m_path))
+      {
+      case Loading:
+        m_pendingPaths.push_back(std::move(path));
+        break;
+      case Loaded:
+        if (path.m_loaded)
+          path.m_loaded(m_model->revealPath(path.m_path));
+        break;
+      case Missing:
+        // a detached root whose directory is gone or excluded by the new root
+        DropDetached(path.m_path);
+        break;
+      }
+    }
+  }
+
+  /// Re-lists dirs whose stamps changed, dirs already waiting for a listing are skipped
+  void StartRefresh(std::vector<Node *> const & dirs)
+  {
+    // batches never mix devices, so the scheduler applies the right limit to each of them
+    std::map<quint64, std::vector<RefreshItem> > itemsByDevice;
+    for (Node * dir : dirs)
+    {
+      if (dir->GetStatus() != Node::Finished || dir->GetDirStat() == nullptr || m_refreshNodes.contains(dir))
+        continue;
+
+      RefreshItem item;
+      item.m_token = dir;
+      item.m_path = BuildPath(dir);
+      item.m_stat = *dir->GetDirStat();
+      item.m_relativePath = BuildRelativePath(dir);
+      item.m_rules = FindRules(dir);
+
+      std::vector<RefreshItem> & items = itemsByDevice[item.m_stat.m_device];
+      items.push_back(std::move(item));
+      m_refreshNodes.insert(dir);
+
+      // several batches let the pool stat directories in parallel, it matters on network mounts
+      if (items.size() == RefreshBatchSize)
+        StartRefreshScaner(std::move(items));
+    }
+
+    for (auto & items : itemsByDevice)
+    {
+      if (!items.second.empty())
+        StartRefreshScaner(std::move(items.second));
+    }
+  }
+
+  void StartRefreshScaner(std::vector<RefreshItem> && items)
+  {
+    quint64 const device = items.front().m_stat.m_device;
+    RefreshScaner * scaner = new RefreshScaner(std::move(items), m_pool);
+    VERIFY(QObject::connect(scaner, &RefreshScaner::dirChanged,
+                            m_model, &FileSystemModel::dirChanged, Qt::QueuedConnection));
+    VERIFY(QObject::connect(scaner, &RefreshScaner::refreshFinished,
+                            m_model, &FileSystemModel::refreshFinished, Qt::QueuedConnection));
+    scaner->setAutoDelete(false);
+
+    m_refreshScaners.insert(scaner);
+    m_scheduler.start(scaner, device);
+    items.clear();
+  }
+
+  /// Makes children up to limit visible to views with a single insert
+  void ExposeRows(Node * node, size_t limit)
+  {
+    size_t const exposedCount = node->GetExposedCount();
+    size_t const count = std::min(node->GetChildCount(), limit);
+    if (count <= exposedCount)
+      return;
+
+    QModelIndex parentIndex = m_model->createIndex(node->GetChildIndex(), 0, node);
+    m_model->beginInsertRows(parentIndex, static_cast<int>(exposedCount), static_cast<int>(count) - 1);
+    node->SetExposedCount(count);
+    m_model->endInsertRows();
+  }
+
+  /// Scanned rows are exposed once per event loop pass instead of one insert per entry
+  void ScheduleExpose(Node * node)
+  {
+    m_unexposedNodes.insert(node);
+    if (m_exposeScheduled)
+      return;
+
+    m_exposeScheduled = true;
+    QTimer::singleShot(0, m_model, [this]()
+    {
+      m_exposeScheduled = false;
+      QSet<Node *> nodes;
+      nodes.swap(m_unexposedNodes);
+      for (Node * node : nodes)
+        ExposeRows(node, node->GetPageLimit());
+    });
+  }
+
   using TScanerIndex = std::map<DirScaner *, Node *>;
   TScanerIndex m_scanerIndex;
+
+  /// Directories still waiting for their refresh listing, removed nodes are erased from here
+  QSet<Node *> m_refreshNodes;
+  std::set<RefreshScaner *> m_refreshScaners;
+
+  QSet<Node *> m_unexposedNodes;
+  bool m_exposeScheduled = false;
 };
 
-QVariant getName(Node const * node)
+QVariant getName(Node const * node, FieldContext const & context)
+{
+  return context.m_pool.Get(node->GetName());
+}
+
+QVariant getSize(Node const * node)
 {
-  QFileInfo info = node->GetInfo();
-  if (info.isRoot())
-    return info.absolutePath();
-  return info.fileName();
+  EntryInfo const & info = node->GetInfo();
+  if (info.IsDir())
+    return QVariant();
+  return info.m_size;
 }
 
-QVariant getSize(Node const * node)
+QVariant toDateTime(qint64 time)
 {
-  QFileInfo const & info = node->GetInfo();
-  if (info.isDir())
+  if (time == EntryInfo::InvalidTime)
     return QVariant();
-  return info.size();
+  return QDateTime::fromMSecsSinceEpoch(time);
 }
 
 QVariant getCreatedTime(Node const * node)
 {
-  return node->GetInfo().created();
+  return toDateTime(node->GetInfo().m_createdTime);
 }
 
 QVariant getModifiedTime(Node const * node)
 {
-  return node->GetInfo().lastModified();
+  return toDateTime(node->GetInfo().m_modifiedTime);
+}
+
+QVariant getHash(Node const * node, FieldContext const & context)
+{
+  // directories and archive members have no content of their own on disk
+  EntryInfo const & info = node->GetInfo();
+  if (info.IsDir() || info.IsVirtual())
+    return QVariant();
+
+  QByteArray const hash = context.m_lazy.GetHash(node);
+  if (hash.isEmpty())
+    return QVariant();
+
+  return QString::fromLatin1(hash.toHex());
+}
+
+QVariant getType(Node const * node, FieldContext const & context)
+{
+  EntryInfo const & info = node->GetInfo();
+  if (info.IsDir())
+    return QStringLiteral("inode/directory");
+
+  quint16 const typeId = context.m_lazy.GetTypeId(node);
+  if (typeId == PendingType)
+    return QVariant();
+
+  return GetTypeName(typeId);
 }
 
 QVariant getOwner(Node const * node)
 {
-  return node->GetInfo().owner();
+  return GetOwnerName(node->GetInfo().m_ownerId);
 }
 
 QVariant getPremission(Node const * node)
 {
-  return QString::number(static_cast<int>(node->GetInfo().permissions()), 16);
+  return QString::number(node->GetInfo().m_permissions, 16);
 }
 
 QVariant getCheckState(Node const * node)
@@ -190,37 +1386,58 @@ QVariant getCheckState(Node const * node)
   return node->GetCheckState();
 }
 
-QVariant getIcon(Node const * node)
+QVariant getSummary(Node const * node, FieldContext const & context)
+{
+  QHash<Node const *, QString>::const_iterator error = context.m_scanErrors.constFind(node);
+  if (error != context.m_scanErrors.constEnd())
+    return QStringLiteral("Cannot be read: %1").arg(error.value());
+
+  Node::Summary const & summary = node->GetSummary();
+  if (node->GetStatus() != Node::NotScaned || summary.m_count == 0)
+    return QVariant();
+
+  return QStringLiteral("Unloaded: %1 entries, %2 bytes").arg(summary.m_count).arg(summary.m_size);
+}
+
+QVariant getIcon(Node const * node, FieldContext const & context)
 {
   static QIcon rootIcon(QStringLiteral(":/assets/root.png"));
   static QIcon folderIcon(QStringLiteral(":/assets/folder.png"));
   static QIcon fileIcon(QStringLiteral(":/assets/file.png"));
 
-  QFileInfo const & info = node->GetInfo();
-  if (info.isRoot())
+  EntryInfo const & info = node->GetInfo();
+  if (info.IsRoot())
     return rootIcon;
-  else if (info.isDir())
+  else if (info.IsDir())
     return folderIcon;
 
-  return fileIcon;
+  // an O(1) lookup once the type is known, icons are shared by every file of the type
+  quint16 const typeId = context.m_lazy.GetTypeId(node);
+  if (typeId == PendingType)
+    return fileIcon;
+
+  return context.m_lazy.GetTypeIcon(typeId, fileIcon);
 }
 
 class FieldHelper
 {
-  using TFieldGetter = function<QVariant (Node const *)>;
+  using TFieldGetter = function<QVariant (Node const *, FieldContext const &)>;
   using TStateGetters = QHash<int, TFieldGetter>;
 public:
   FieldHelper()
   {
-    addField(bind(&getName, _1), "Name");
+    addField(bind(&getName, _1, _2), "Name");
     addField(bind(&getSize, _1), "Size");
     addField(bind(&getCreatedTime, _1), "Created");
     addField(bind(&getModifiedTime, _1), "Modified");
+    addField(bind(&getHash, _1, _2), "Hash");
+    addField(bind(&getType, _1, _2), "Type");
     addField(bind(&getOwner, _1), "Owner");
     addField(bind(&getPremission, _1), "Permissions");
 
     m_stateGetters[Qt::CheckStateRole] = bind(&getCheckState, _1);
-    m_stateGetters[Qt::DecorationRole] = bind(&getIcon, _1);
+    m_stateGetters[Qt::DecorationRole] = bind(&getIcon, _1, _2);
+    m_stateGetters[Qt::ToolTipRole] = bind(&getSummary, _1, _2);
     //m_stateGetters[Qt::TextAlignmentRole] = bind(&getTextAlign, _1);
   }
 
@@ -229,15 +1446,15 @@ public:
     return m_fieldGetters.size();
   }
 
-  QVariant getFieldValue(Node const * node, int column, int role) const
+  QVariant getFieldValue(Node const * node, FieldContext const & context, int column, int role) const
   {
     if (role == Qt::DisplayRole)
-      return m_fieldGetters[column](node);
+      return m_fieldGetters[column](node, context);
     else if (column == 0)
     {
       TStateGetters::const_iterator fn = m_stateGetters.find(role);
       if (fn != m_stateGetters.end())
-        return fn.value()(node);
+        return fn.value()(node, context);
     }
 
     return QVariant();
@@ -278,7 +1495,7 @@ public:
     if (node == nullptr)
       return false;
 
-    return node->GetInfo().isDir();
+    return node->GetInfo().IsContainer();
   }
 
 private:
@@ -292,7 +1509,8 @@ private:
       setCheckStateForChildren(child, state, fn);
     }
 
-    fn(parent, std::make_pair(0, childCount - 1), std::make_pair(0, 0), Qt::CheckStateRole);
+    int exposedCount = static_cast<int>(parent->GetExposedCount());
+    fn(parent, std::make_pair(0, exposedCount - 1), std::make_pair(0, 0), Qt::CheckStateRole);
   }
 
   void setCheckStateForParent(Node * node, Qt::CheckState state, TDataChanged const & fn) const
@@ -343,6 +1561,9 @@ FileSystemModel::FileSystemModel(QObject * parent)
   : TBase(parent)
   , m_impl(new Impl(this))
 {
+  VERIFY(QObject::connect(&m_impl->m_hashService, &HashService::hashReady, this, &FileSystemModel::hashReady));
+  VERIFY(QObject::connect(&m_impl->m_hashService, &HashService::hashFailed, this, &FileSystemModel::hashFailed));
+  VERIFY(QObject::connect(&m_impl->m_hashService, &HashService::hashDropped, this, &FileSystemModel::hashDropped));
 }
 
 FileSystemModel::~FileSystemModel()
@@ -351,17 +1572,369 @@ FileSystemModel::~FileSystemModel()
   m_impl.reset();
 }
 
-void FileSystemModel::setRoot(QString const & rootPath)
+void FileSystemModel::addRoot(QString const & rootPath)
+{
+  if (rootPath.isEmpty() || !QFileInfo(rootPath).exists())
+    return;
+
+  QString const cleanPath = CleanPath(rootPath);
+  if (m_impl->m_rootPaths.contains(cleanPath))
+    return;
+
+  m_impl->m_rootPaths.append(cleanPath);
+  m_impl->m_rootLines.insert(cleanPath, m_impl->m_ignoreLines);
+
+  // a root inside a loaded one shares its nodes
+  if (m_impl->FindContainingRoot(cleanPath) != nullptr)
+    return;
+
+  for (size_t row = m_impl->m_roots.size(); row-- > 0;)
+  {
+    if (IsInside(m_impl->m_roots[row].m_path, cleanPath))
+      m_impl->DetachRoot(row);
+  }
+
+  std::vector<Root> roots;
+  roots.push_back(m_impl->MakeRoot(cleanPath));
+  m_impl->InsertRoots(std::move(roots));
+
+  // the directories down to every detached root are listed, so they are grafted soon
+  m_impl->LoadDetached();
+}
+
+void FileSystemModel::removeRoot(QString const & rootPath)
+{
+  QString const cleanPath = CleanPath(rootPath);
+  if (!m_impl->m_rootPaths.removeOne(cleanPath))
+    return;
+
+  m_impl->m_rootLines.remove(cleanPath);
+
+  // a nested root is a node of its container, nothing is dropped
+  std::vector<Root>::iterator rootIt = std::find_if(m_impl->m_roots.begin(), m_impl->m_roots.end(),
+                                                    [&cleanPath](Root const & root) { return root.m_path == cleanPath; });
+  if (rootIt == m_impl->m_roots.end())
+    return;
+
+  // roots still open inside it become top level rows, with their nodes when they are loaded
+  QStringList topmostPaths;
+  for (QString const & path : m_impl->m_rootPaths)
+  {
+    if (!IsInside(path, cleanPath))
+      continue;
+
+    bool isNested = false;
+    for (QString const & other : m_impl->m_rootPaths)
+      isNested = isNested || (other != path && IsInside(path, other));
+
+    if (!isNested)
+      topmostPaths.append(path);
+  }
+
+  int const row = static_cast<int>(rootIt - m_impl->m_roots.begin());
+  Node * rootNode = rootIt->m_node.get();
+  std::vector<Root> promoted;
+  beginRemoveRows(QModelIndex(), row, row);
+  for (QString const & path : topmostPaths)
+  {
+    std::vector<Root>::iterator detached = std::find_if(m_impl->m_detached.begin(), m_impl->m_detached.end(),
+                                                        [&path](Root const & root) { return root.m_path == path; });
+    if (detached != m_impl->m_detached.end())
+    {
+      promoted.push_back(std::move(*detached));
+      m_impl->m_detached.erase(detached);
+      continue;
+    }
+
+    Node * node = m_impl->FindNode(path, false);
+    if (node == nullptr)
+    {
+      if (QFileInfo(path).exists())
+        promoted.push_back(m_impl->MakeRoot(path));
+      continue;
+    }
+
+    Root root;
+    root.m_path = path;
+    root.m_rules = m_impl->MakeRootRules(path);
+    root.m_device = m_impl->GetDevice(node);
+    m_impl->ForgetRules(node);
+    root.m_node = node->GetParent()->TakeChild(node->GetChildIndex());
+    // views drop the expanded state of removed rows without a collapse
+    root.m_node->ResetExpanded();
+    promoted.push_back(std::move(root));
+  }
+
+  m_impl->ForgetSubtree(rootNode);
+  m_impl->m_roots.erase(m_impl->m_roots.begin() + row);
+  m_impl->RenumberRoots();
+  endRemoveRows();
+
+  m_impl->InsertRoots(std::move(promoted));
+
+  // detached roots below the removed one wait for their new container or go away with it
+  m_impl->LoadDetached();
+  m_impl->CompactPool();
+}
+
+void FileSystemModel::clearRoots()
 {
   beginResetModel();
   cleanModel();
-  QFileInfo info(rootPath);
-  if (!rootPath.isEmpty() && info.exists())
+  m_impl->m_evictionThreshold = m_impl->m_memoryBudget;
+  endResetModel();
+}
+
+QStringList FileSystemModel::roots() const
+{
+  return m_impl->m_rootPaths;
+}
+
+void FileSystemModel::loadPath(QString const & path, function<void (QModelIndex const &)> const & loaded)
+{
+  QString const cleanPath = CleanPath(path);
+  m_impl->m_pendingPaths.push_back(Impl::PendingPath{ cleanPath, loaded });
+  m_impl->LoadPending();
+}
+
+void FileSystemModel::setIgnoreRules(QStringList const & rules, bool readGitIgnore)
+{
+  m_impl->m_ignoreLines = rules;
+  m_impl->m_readGitIgnore = readGitIgnore;
+}
+
+void FileSystemModel::setHashAlgorithm(HashService::EAlgorithm algorithm)
+{
+  if (m_impl->m_hashService.algorithm() == algorithm)
+    return;
+
+  m_impl->m_hashService.clear();
+  m_impl->m_hashService.setAlgorithm(algorithm);
+  m_impl->m_hashes.clear();
+  m_impl->m_hashPending.clear();
+}
+
+void FileSystemModel::hashChecked()
+{
+  std::vector<Node const *> nodes;
+  for (Root const & root : m_impl->m_roots)
+    nodes.push_back(root.m_node.get());
+
+  while (!nodes.empty())
   {
-    m_impl->m_root.reset(new Node(info));
-    m_impl->RunScaner(m_impl->m_root.get());
+    Node const * node = nodes.back();
+    nodes.pop_back();
+    if (node->GetCheckState() == Qt::Unchecked || node->GetInfo().IsVirtual())
+      continue;
+
+    if (!node->GetInfo().IsDir() && !m_impl->m_hashes.contains(node))
+      m_impl->RequestHash(node, true);
+
+    for (size_t i = 0; i < node->GetChildCount(); ++i)
+      nodes.push_back(node->GetChild(i));
   }
-  endResetModel();
+}
+
+PruneCount FileSystemModel::pruneCount() const
+{
+  return m_impl->m_pruneCount;
+}
+
+void FileSystemModel::setMemoryBudget(qint64 bytes)
+{
+  m_impl->m_memoryBudget = bytes;
+  m_impl->m_evictionThreshold = bytes;
+  scheduleEviction();
+}
+
+qint64 FileSystemModel::memoryUsage() const
+{
+  return static_cast<qint64>(m_impl->m_nodeCount) * NodeMemoryCost + m_impl->m_pool->GetUsedBytes();
+}
+
+void FileSystemModel::setExpanded(QModelIndex const & index, bool expanded)
+{
+  if (!index.isValid())
+    return;
+
+  Q_ASSERT(index.internalPointer() != nullptr);
+  Node * node = static_cast<Node *>(index.internalPointer());
+  node->SetExpanded(expanded);
+  m_impl->Touch(node);
+}
+
+void FileSystemModel::resetExpanded()
+{
+  for (Root const & root : m_impl->m_roots)
+    root.m_node->ResetExpanded();
+}
+
+QString FileSystemModel::filePath(QModelIndex const & index) const
+{
+  if (!index.isValid())
+    return QString();
+
+  Q_ASSERT(index.internalPointer() != nullptr);
+  return m_impl->BuildPath(static_cast<Node *>(index.internalPointer()));
+}
+
+ExportSnapshot FileSystemModel::checkedSnapshot() const
+{
+  ExportSnapshot snapshot;
+  snapshot.m_pool = m_impl->m_pool;
+  std::vector<Node const *> expanded;
+  for (Root const & root : m_impl->m_roots)
+  {
+    snapshot.m_rootPaths.append(root.m_path);
+    CollectChecked(root.m_node.get(), 0, snapshot.m_entries, expanded);
+  }
+
+  // the exporter prunes what the scaners would have pruned
+  snapshot.m_expandRoots.reserve(expanded.size());
+  for (Node const * node : expanded)
+    snapshot.m_expandRoots.push_back(m_impl->MakeCrawlRoot(node));
+
+  return snapshot;
+}
+
+QStringList FileSystemModel::checkedPaths() const
+{
+  std::vector<Node const *> roots;
+  for (Root const & root : m_impl->m_roots)
+    CollectCheckedRoots(root.m_node.get(), roots);
+
+  QStringList paths;
+  paths.reserve(static_cast<int>(roots.size()));
+  for (Node const * node : roots)
+    paths.append(m_impl->BuildPath(node));
+
+  return paths;
+}
+
+std::shared_ptr<ScanSnapshot> FileSystemModel::takeSnapshot(QString const & rootPath) const
+{
+  std::shared_ptr<ScanSnapshot> snapshot = std::make_shared<ScanSnapshot>();
+  snapshot->m_pool = m_impl->m_pool;
+  snapshot->m_rootPath = CleanPath(rootPath);
+  Node * root = m_impl->FindNode(rootPath, false);
+  if (root == nullptr)
+    return snapshot;
+
+  // level order, children of every node are appended together in row order,
+  // the name order the snapshot needs is sorted off the GUI thread
+  snapshot->m_isSorted = false;
+  std::vector<Node *> nodes(1, root);
+  std::vector<SnapshotEntry> & entries = snapshot->m_entries;
+  entries.reserve(m_impl->m_nodeCount);
+  entries.resize(1);
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    Node * node = nodes[i];
+    EntryInfo const & info = node->GetInfo();
+
+    SnapshotEntry entry;
+    entry.m_name = info.m_name;
+    entry.m_size = info.m_size;
+    entry.m_modifiedTime = info.m_modifiedTime;
+    entry.m_firstChild = static_cast<quint32>(nodes.size());
+    if (info.IsDir())
+      entry.m_flags |= SnapshotEntry::Dir;
+    if (node->GetStatus() == Node::Finished)
+      entry.m_flags |= SnapshotEntry::Listed;
+
+    // archive members are not on disk, snapshots describe only the file system
+    if (info.IsDir() && !info.IsVirtual())
+    {
+      for (size_t child = 0; child < node->GetChildCount(); ++child)
+        nodes.push_back(node->GetChild(child));
+    }
+
+    entry.m_childCount = static_cast<quint32>(nodes.size()) - entry.m_firstChild;
+    entries.resize(nodes.size());
+    entries[i] = entry;
+  }
+
+  return snapshot;
+}
+
+std::shared_ptr<NameList const> FileSystemModel::loadedNames() const
+{
+  std::shared_ptr<NameList> names = std::make_shared<NameList>();
+  names->m_pool = m_impl->m_pool;
+  names->m_names.reserve(m_impl->m_nodeCount);
+  std::vector<Node const *> stack;
+  for (auto it = m_impl->m_roots.rbegin(); it != m_impl->m_roots.rend(); ++it)
+    stack.push_back(it->m_node.get());
+
+  while (!stack.empty())
+  {
+    Node const * node = stack.back();
+    stack.pop_back();
+    // the name of a root is its whole path, the filter never matches it
+    if (!node->GetInfo().IsRoot())
+      names->m_names.push_back(node->GetInfo().m_name);
+    for (size_t i = node->GetChildCount(); i > 0; --i)
+      stack.push_back(node->GetChild(i - 1));
+  }
+
+  return names;
+}
+
+CrawlRoot FileSystemModel::crawlRoot(QModelIndex const & index) const
+{
+  CrawlRoot root;
+  if (!index.isValid())
+    return root;
+
+  Q_ASSERT(index.internalPointer() != nullptr);
+  return m_impl->MakeCrawlRoot(static_cast<Node const *>(index.internalPointer()));
+}
+
+CrawlRoot FileSystemModel::crawlRoot(QString const & path) const
+{
+  if (Node const * node = m_impl->FindNode(path, false))
+    return m_impl->MakeCrawlRoot(node);
+
+  CrawlRoot root;
+  root.m_path = CleanPath(path);
+  root.m_readGitIgnore = m_impl->m_readGitIgnore;
+  return root;
+}
+
+QString FileSystemModel::scanDiagnostics() const
+{
+  PruneCount const & pruned = m_impl->m_pruneCount;
+  QString diagnostics = m_impl->m_scheduler.diagnostics() +
+      QStringLiteral("\npruned by exclusion rules: %1 directories, %2 files").arg(pruned.m_dirs).arg(pruned.m_files);
+  if (quint64 const failed = m_impl->m_failedNames + m_impl->m_pool->GetFailedCount())
+    diagnostics += QStringLiteral("\nleft out, the name pool is full: %1 entries").arg(failed);
+  if (!m_impl->m_scanErrors.isEmpty())
+    diagnostics += QStringLiteral("\nunreadable archives: %1").arg(m_impl->m_scanErrors.size());
+  return diagnostics;
+}
+
+QModelIndex FileSystemModel::indexForPath(QString const & path) const
+{
+  Node * node = m_impl->FindNode(path, false);
+  if (node == nullptr)
+    return QModelIndex();
+
+  for (Node const * n = node; n->GetParent() != nullptr; n = n->GetParent())
+  {
+    if (static_cast<size_t>(n->GetChildIndex()) >= n->GetParent()->GetExposedCount())
+      return QModelIndex();
+  }
+
+  return createIndex(node->GetChildIndex(), 0, node);
+}
+
+QModelIndex FileSystemModel::revealPath(QString const & path)
+{
+  Node * node = m_impl->FindNode(path, true);
+  if (node == nullptr)
+    return QModelIndex();
+
+  return createIndex(node->GetChildIndex(), 0, node);
 }
 
 bool FileSystemModel::isDir(QModelIndex const & index) const
@@ -372,11 +1945,26 @@ bool FileSystemModel::isDir(QModelIndex const & index) const
 int FileSystemModel::rowCount(QModelIndex const & parent) const
 {
   if (!parent.isValid())
-    return m_impl->m_root ? 1 : 0;
+    return static_cast<int>(m_impl->m_roots.size());
 
   Q_ASSERT(parent.internalPointer() != nullptr);
   Node * node = static_cast<Node *>(parent.internalPointer());
-  return node->GetChildCount();
+  m_impl->Touch(node);
+  return node->GetExposedCount();
+}
+
+bool FileSystemModel::hasChildren(QModelIndex const & parent) const
+{
+  if (!parent.isValid())
+    return !m_impl->m_roots.empty();
+
+  Q_ASSERT(parent.internalPointer() != nullptr);
+  Node * node = static_cast<Node *>(parent.internalPointer());
+  if (node->GetChildCount() > 0)
+    return true;
+
+  // not scanned yet or evicted, expanding it scans the directory again
+  return node->GetStatus() != Node::Finished && node->GetInfo().IsContainer();
 }
 
 int FileSystemModel::columnCount(QModelIndex const & /*parent*/) const
@@ -388,7 +1976,7 @@ QModelIndex FileSystemModel::index(int row, int column, QModelIndex const & pare
 {
   Node * node = static_cast<Node *>(parent.internalPointer());
   if (node == nullptr)
-    return createIndex(row, column, m_impl->m_root.get());
+    return createIndex(row, column, m_impl->m_roots[row].m_node.get());
 
   return createIndex(row, column, node->GetChild(row));
 }
@@ -410,7 +1998,8 @@ QVariant FileSystemModel::data(QModelIndex const & index, int role) const
 {
   Q_ASSERT(index.internalPointer() != nullptr);
   Node * node = static_cast<Node *>(index.internalPointer());
-  return s_helper.getFieldValue(node, index.column(), role);
+  FieldContext const context = { *m_impl->m_pool, *m_impl, m_impl->m_scanErrors };
+  return s_helper.getFieldValue(node, context, index.column(), role);
 }
 
 bool FileSystemModel::setData(QModelIndex const & index, QVariant const & value, int role)
@@ -461,6 +2050,9 @@ bool FileSystemModel::canFetchMore(QModelIndex const & parent) const
 
   Q_ASSERT(parent.internalPointer() != nullptr);
   Node * node = static_cast<Node *>(parent.internalPointer());
+  if (node->GetExposedCount() < node->GetChildCount())
+    return true;
+
   if (node->GetStatus() == Node::Finished)
     return false;
 
@@ -474,8 +2066,11 @@ void FileSystemModel::fetchMore(QModelIndex const & parent)
 
   Q_ASSERT(parent.internalPointer() != nullptr);
   Node * node = static_cast<Node *>(parent.internalPointer());
+  m_impl->Touch(node);
   if (node->GetStatus() == Node::NotScaned)
     m_impl->RunScaner(node);
+  else
+    m_impl->ExposeRows(node, node->GetExposedCount() + PageSize);
 }
 
 void FileSystemModel::emitDataChanged(QModelIndex const & from, QModelIndex const & to, int role)
@@ -484,7 +2079,14 @@ void FileSystemModel::emitDataChanged(QModelIndex const & from, QModelIndex cons
   emit dataChanged(from, to, QVector<int>{ role });
 }
 
-void FileSystemModel::fileFounded(QFileInfo const & info, DirScaner * scaner)
+void FileSystemModel::rulesFounded(TIgnoreRules const & rules, DirScaner * scaner)
+{
+  Impl::TScanerIndex::iterator nodeIter = m_impl->m_scanerIndex.find(scaner);
+  if (nodeIter != m_impl->m_scanerIndex.end())
+    m_impl->m_dirRules.insert(nodeIter->second, rules);
+}
+
+void FileSystemModel::entriesFounded(EntryBatch const & batch, DirScaner * scaner)
 {
   Impl::TScanerIndex::iterator nodeIter = m_impl->m_scanerIndex.find(scaner);
   if (nodeIter == m_impl->m_scanerIndex.end())
@@ -493,24 +2095,223 @@ void FileSystemModel::fileFounded(QFileInfo const & info, DirScaner * scaner)
   Node * fileNode = nodeIter->second;
   Q_ASSERT(fileNode->GetStatus() == Node::Running);
 
-  QString fileName = info.fileName();
-  if (fileName != "." && fileName != "..")
+  QString const dirPath = m_impl->m_detached.empty() ? QString() : m_impl->BuildPath(fileNode);
+  for (EntryInfo const & entry : batch.m_entries)
   {
-    int rowIndex = fileNode->GetChildCount();
-    beginInsertRows(createIndex(fileNode->GetChildIndex(), 0, fileNode), rowIndex, rowIndex);
-    fileNode->AddChild(info);
-    endInsertRows();
+    // a grafted root is already counted
+    if (entry.IsDir() && !m_impl->m_detached.empty() && m_impl->GraftDetached(fileNode, dirPath, entry))
+      --m_impl->m_nodeCount;
+    else
+      fileNode->AddChild(entry);
   }
+
+  m_impl->ScheduleExpose(fileNode);
+  m_impl->m_nodeCount += batch.m_entries.size();
+  scheduleEviction();
+}
+
+void FileSystemModel::scanFailed(QString const & error, DirScaner * scaner)
+{
+  Impl::TScanerIndex::iterator nodeIter = m_impl->m_scanerIndex.find(scaner);
+  if (nodeIter == m_impl->m_scanerIndex.end())
+    return;
+
+  Node * node = nodeIter->second;
+  m_impl->m_scanErrors.insert(node, error);
+
+  Node const * parent = node->GetParent();
+  int const row = node->GetChildIndex();
+  if (parent != nullptr && row >= static_cast<int>(parent->GetExposedCount()))
+    return;
+
+  emit dataChanged(createIndex(row, 0, node), createIndex(row, 0, node), QVector<int>{ Qt::ToolTipRole });
 }
 
-void FileSystemModel::scanFinished(DirScaner * scaner)
+void FileSystemModel::scanFinished(FileStat const & dirStat, PruneCount const & pruned, DirScaner * scaner)
 {
   Impl::TScanerIndex::iterator nodeIter = m_impl->m_scanerIndex.find(scaner);
   if (nodeIter == m_impl->m_scanerIndex.end())
     return;
 
-  nodeIter->second->SetStatus(Node::Finished);
+  m_impl->m_pruneCount.m_files += pruned.m_files;
+  m_impl->m_pruneCount.m_dirs += pruned.m_dirs;
+
+  // archives and their members are re-read when the archive itself changes, not by refresh
+  Node * node = nodeIter->second;
+  node->SetStatus(Node::Finished);
+  if (!node->GetInfo().IsArchive() && !node->GetInfo().IsVirtual())
+    node->SetDirStat(dirStat);
   m_impl->m_scanerIndex.erase(nodeIter);
+
+  if (!m_impl->m_pendingPaths.empty())
+    m_impl->LoadPending();
+
+  if (m_impl->m_isCompactPending)
+    m_impl->CompactPool();
+}
+
+void FileSystemModel::refresh()
+{
+  if (!m_impl->m_refreshScaners.empty())
+    return;
+
+  std::vector<Node *> dirs;
+  for (Root const & root : m_impl->m_roots)
+    CollectScanedDirs(root.m_node.get(), dirs);
+  m_impl->StartRefresh(dirs);
+}
+
+void FileSystemModel::refreshDirs(QStringList const & paths)
+{
+  std::vector<Node *> dirs;
+  for (QString const & path : paths)
+  {
+    Node * node = m_impl->FindNode(path, false);
+    if (node != nullptr)
+      dirs.push_back(node);
+  }
+
+  m_impl->StartRefresh(dirs);
+}
+
+void FileSystemModel::dirChanged(DirListing const & listing, RefreshScaner * scaner)
+{
+  if (m_impl->m_refreshScaners.count(scaner) == 0)
+    return;
+
+  Node * node = static_cast<Node *>(listing.m_token);
+  if (!m_impl->m_refreshNodes.remove(node) || node->GetStatus() != Node::Finished)
+    return;
+
+  m_impl->MergeListing(node, listing.m_entries);
+  node->SetDirStat(listing.m_stat);
+}
+
+void FileSystemModel::refreshFinished(RefreshScaner * scaner)
+{
+  if (m_impl->m_refreshScaners.erase(scaner) > 0 && m_impl->m_refreshScaners.empty())
+    m_impl->m_refreshNodes.clear();
+
+  scaner->deleteLater();
+
+  if (m_impl->m_isCompactPending)
+    m_impl->CompactPool();
+}
+
+void FileSystemModel::hashReady(QString const & path, QByteArray const & hash)
+{
+  Node * node = m_impl->FindNode(path, false);
+  if (node == nullptr || !m_impl->m_hashPending.remove(node))
+    return;
+
+  m_impl->m_hashes.insert(node, hash);
+
+  Node const * parent = node->GetParent();
+  int const row = node->GetChildIndex();
+  if (parent != nullptr && row >= static_cast<int>(parent->GetExposedCount()))
+    return;
+
+  emit dataChanged(createIndex(row, 0, node), createIndex(row, columnCount(QModelIndex()) - 1, node),
+                   QVector<int>{ Qt::DisplayRole });
+}
+
+void FileSystemModel::hashFailed(QString const & path, QString const & /*error*/)
+{
+  // not asked again until the file changes or is listed anew
+  Node * node = m_impl->FindNode(path, false);
+  if (node != nullptr && m_impl->m_hashPending.remove(node))
+    m_impl->m_hashes.insert(node, QByteArray());
+}
+
+void FileSystemModel::hashDropped(QString const & path)
+{
+  // asked again when the row is painted again
+  Node * node = m_impl->FindNode(path, false);
+  QHash<Node const *, bool>::iterator pending = m_impl->m_hashPending.find(node);
+  if (pending != m_impl->m_hashPending.end() && !pending.value())
+    m_impl->m_hashPending.erase(pending);
+}
+
+void FileSystemModel::typesDetected(TypeBatch const & batch, TypeDetector * detector)
+{
+  detector->deleteLater();
+  for (TypeResult const & result : batch.m_results)
+  {
+    // the file may be gone or listed anew since it was requested
+    Node * node = m_impl->FindNode(result.m_path, false);
+    if (node == nullptr || node->GetTypeId() != PendingType)
+      continue;
+
+    node->SetTypeId(result.m_typeId);
+
+    Node const * parent = node->GetParent();
+    int const row = node->GetChildIndex();
+    if (parent != nullptr && row >= static_cast<int>(parent->GetExposedCount()))
+      continue;
+
+    emit dataChanged(createIndex(row, 0, node), createIndex(row, columnCount(QModelIndex()) - 1, node),
+                     QVector<int>{ Qt::DisplayRole, Qt::DecorationRole });
+  }
+}
+
+void FileSystemModel::scheduleEviction()
+{
+  if (m_impl->m_memoryBudget <= 0 || m_impl->m_evictionScheduled)
+    return;
+
+  if (memoryUsage() <= std::max(m_impl->m_memoryBudget, m_impl->m_evictionThreshold))
+    return;
+
+  m_impl->m_evictionScheduled = true;
+  QTimer::singleShot(0, this, [this]() { evictSubtrees(); });
+}
+
+void FileSystemModel::evictSubtrees()
+{
+  m_impl->m_evictionScheduled = false;
+  if (m_impl->m_memoryBudget <= 0)
+    return;
+
+  // detached roots have no rows to remove, they are grafted or dropped soon
+  std::vector<EvictionCandidate> candidates;
+  for (Root const & root : m_impl->m_roots)
+  {
+    quint32 lastAccess = 0;
+    quint64 nodeCount = 0;
+    CollectEvictionCandidates(root.m_node.get(), candidates, lastAccess, nodeCount);
+  }
+
+  std::sort(candidates.begin(), candidates.end(), [](EvictionCandidate const & l, EvictionCandidate const & r)
+  {
+    return l.m_lastAccess < r.m_lastAccess;
+  });
+
+  // evict below the budget to not walk the tree again on the next few inserted rows.
+  // Names are freed by the compaction afterwards, until then the pool is expected
+  // to shrink with the node count.
+  qint64 const target = m_impl->m_memoryBudget / 4 * 3;
+  qint64 const poolBytes = m_impl->m_pool->GetUsedBytes();
+  quint64 const nodeCount = std::max<quint64>(1, m_impl->m_nodeCount);
+  auto expectedUsage = [this, poolBytes, nodeCount]()
+  {
+    return static_cast<qint64>(m_impl->m_nodeCount) * NodeMemoryCost +
+           static_cast<qint64>(poolBytes * static_cast<double>(m_impl->m_nodeCount) / nodeCount);
+  };
+  bool isEvicted = false;
+  for (EvictionCandidate const & candidate : candidates)
+  {
+    if (expectedUsage() <= target)
+      break;
+
+    m_impl->EvictNode(candidate.m_node);
+    isEvicted = true;
+  }
+
+  // everything left is pinned, wait until the tree grows noticeably before the next walk
+  m_impl->m_evictionThreshold = std::max(m_impl->m_memoryBudget,
+                                         memoryUsage() + m_impl->m_memoryBudget / 8);
+  if (isEvicted)
+    m_impl->CompactPool();
 }
 
 void FileSystemModel::cleanModel()
@@ -520,6 +2321,31 @@ void FileSystemModel::cleanModel()
     node.first->cancel();
 
   m_impl->m_scanerIndex.clear();
-  m_impl->m_root.reset();
+
+  for (RefreshScaner * scaner : m_impl->m_refreshScaners)
+    scaner->cancel();
+
+  m_impl->m_refreshScaners.clear();
+  m_impl->m_refreshNodes.clear();
+  m_impl->m_unexposedNodes.clear();
+  m_impl->m_dirRules.clear();
+  m_impl->m_scanErrors.clear();
+  m_impl->m_hashService.clear();
+  m_impl->m_hashes.clear();
+  m_impl->m_hashPending.clear();
+  m_impl->m_typeRequests.clear();
+  m_impl->m_pruneCount = PruneCount();
+
+  m_impl->m_roots.clear();
+  m_impl->m_detached.clear();
+  m_impl->m_rootPaths.clear();
+  m_impl->m_rootLines.clear();
+  m_impl->m_pendingPaths.clear();
+  m_impl->m_nodeCount = 0;
+
+  // canceled scaners may still intern into the old pool, they hold their own reference
+  m_impl->m_pool = std::make_shared<NamePool>();
+  m_impl->m_isCompactPending = false;
+  m_impl->m_failedNames = 0;
 }
 
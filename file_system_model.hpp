@@ -1,9 +1,27 @@
 #pragma once
 
+#include "hash_service.hpp"
+
 #include <QAbstractItemModel>
+#include <QFileInfo>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
 
-class QFileInfo;
 class DirScaner;
+class IgnoreRules;
+class RefreshScaner;
+class TypeDetector;
+struct CrawlRoot;
+struct DirListing;
+struct EntryBatch;
+struct ExportSnapshot;
+struct FileStat;
+struct NameList;
+struct PruneCount;
+struct ScanSnapshot;
+struct TypeBatch;
 
 class FileSystemModel : public QAbstractItemModel
 {
@@ -12,10 +30,70 @@ public:
   FileSystemModel(QObject * parent = 0);
   ~FileSystemModel();
 
-  void setRoot(QString const & rootPath);
+  /// Roots share one scan engine and one tree. A root inside an open one is a node of it,
+  /// open roots inside a new one are grafted into it without scanning them again.
+  void addRoot(QString const & rootPath);
+  /// Roots still open inside the removed one become top level rows and keep their nodes
+  void removeRoot(QString const & rootPath);
+  void clearRoots();
+  /// Every added root, nested ones included
+  QStringList roots() const;
+  /// Lists the directories on the way to path, loaded gets its index once it is in the tree.
+  /// It is never called when the path does not exist or is excluded.
+  void loadPath(QString const & path, std::function<void (QModelIndex const &)> const & loaded);
+  /// gitignore style rules for roots added after the call, matching entries are never listed.
+  /// With readGitIgnore .gitignore files found on the way are honored below their directories.
+  void setIgnoreRules(QStringList const & rules, bool readGitIgnore);
+  /// Hash column content, XXH64 by default. Hashes shown so far are dropped.
+  void setHashAlgorithm(HashService::EAlgorithm algorithm);
+  /// Hashes checked loaded files, otherwise only rows shown in the Hash column are hashed
+  void hashChecked();
+  /// Entries left out by the rules since clearRoots
+  PruneCount pruneCount() const;
+  /// Re-lists only the scanned directories whose stamps changed and merges the
+  /// difference into the tree, check states of unchanged entries are kept
+  void refresh();
+  /// Re-lists only the given loaded directories, unknown paths are ignored
+  void refreshDirs(QStringList const & paths);
+  /// Loaded part of the tree below rootPath, shares names with the model
+  std::shared_ptr<ScanSnapshot> takeSnapshot(QString const & rootPath) const;
+  /// Path and exclusion rules for a ParallelCrawler below a directory, an empty path for
+  /// anything that is not a directory on disk
+  CrawlRoot crawlRoot(QModelIndex const & index) const;
+  /// The same for a directory path, no row is exposed. A path outside the loaded tree gets no
+  /// rules of the model, only the .gitignore files below it apply.
+  CrawlRoot crawlRoot(QString const & path) const;
+  /// Names of every loaded entry in tree order, for matching off the GUI thread
+  std::shared_ptr<NameList const> loadedNames() const;
+  /// Per device scan concurrency limits and measured rates
+  QString scanDiagnostics() const;
+  /// Directories and archives, anything that can be expanded
   bool isDir(QModelIndex const & index) const;
+  /// Rebuilt from the names on the way to the root, nodes do not store paths
+  QString filePath(QModelIndex const & index) const;
+
+  /// Checked and partially checked entries for Exporter, cheap enough to take on every export
+  ExportSnapshot checkedSnapshot() const;
+  /// Topmost fully checked entries, everything below them is checked as well
+  QStringList checkedPaths() const;
+
+  /// Index of an already loaded entry, the model is left as is. Invalid when the path is outside
+  /// the roots, not scanned yet or a row on the way is not exposed to views yet.
+  QModelIndex indexForPath(QString const & path) const;
+  /// Index of an already loaded entry, rows on the way that views do not know yet are inserted.
+  /// Invalid when the path is outside the roots or not scanned yet.
+  QModelIndex revealPath(QString const & path);
+
+  /// Collapsed, unchecked, least recently viewed subtrees are dropped back to not scanned
+  /// state when the estimated size of the tree exceeds the budget. 0 means no limit.
+  void setMemoryBudget(qint64 bytes);
+  qint64 memoryUsage() const;
+  /// Expanded nodes are never evicted. Calls are counted, every expand needs a collapse.
+  void setExpanded(QModelIndex const & index, bool expanded);
+  void resetExpanded();
 
   int rowCount(QModelIndex const & parent) const override;
+  bool hasChildren(QModelIndex const & parent) const override;
   int columnCount(QModelIndex const & parent) const override;
 
   QModelIndex index(int row, int column, QModelIndex const & parent) const override;
@@ -33,8 +111,21 @@ public:
 private:
   void emitDataChanged(QModelIndex const & from, QModelIndex const & to, int role);
 
-  Q_SLOT void fileFounded(QFileInfo const & info, DirScaner * scaner);
-  Q_SLOT void scanFinished(DirScaner * scaner);
+  Q_SLOT void rulesFounded(std::shared_ptr<IgnoreRules const> const & rules, DirScaner * scaner);
+  Q_SLOT void entriesFounded(EntryBatch const & batch, DirScaner * scaner);
+  Q_SLOT void scanFailed(QString const & error, DirScaner * scaner);
+  Q_SLOT void scanFinished(FileStat const & dirStat, PruneCount const & pruned, DirScaner * scaner);
+
+  Q_SLOT void hashReady(QString const & path, QByteArray const & hash);
+  Q_SLOT void hashFailed(QString const & path, QString const & error);
+  Q_SLOT void hashDropped(QString const & path);
+  Q_SLOT void typesDetected(TypeBatch const & batch, TypeDetector * detector);
+
+  Q_SLOT void dirChanged(DirListing const & listing, RefreshScaner * scaner);
+  Q_SLOT void refreshFinished(RefreshScaner * scaner);
+
+  void scheduleEviction();
+  void evictSubtrees();
 
   void cleanModel();
 
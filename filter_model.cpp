@@ -0,0 +1,325 @@
+#include "filter_model.hpp"
+#include "macros.hpp"
+#include "filter_scaner.hpp"
+
+#include <QBrush>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QIcon>
+#include <QThreadPool>
+
+namespace
+{
+
+class FilterNode
+{
+public:
+  FilterNode(QFileInfo const & info)
+    : m_info(info)
+  {
+  }
+
+  FilterNode * AddChild(QFileInfo const & info)
+  {
+    m_children.emplace_back(new FilterNode(info, this, m_children.size()));
+    return m_children.back().get();
+  }
+
+  FilterNode * GetParent() const
+  {
+    return m_parent;
+  }
+
+  QFileInfo const & GetInfo() const
+  {
+    return m_info;
+  }
+
+  size_t GetChildCount() const
+  {
+    return m_children.size();
+  }
+
+  FilterNode * GetChild(size_t index) const
+  {
+    Q_ASSERT(index < m_children.size());
+    return m_children[index].get();
+  }
+
+  int GetChildIndex() const
+  {
+    return m_childIndex;
+  }
+
+  bool IsMatched() const
+  {
+    return m_matched;
+  }
+
+  void SetMatched()
+  {
+    m_matched = true;
+  }
+
+private:
+  FilterNode(QFileInfo const & info, FilterNode * parent, int childIndex)
+    : m_info(info)
+    , m_parent(parent)
+    , m_childIndex(childIndex)
+  {
+  }
+
+  QFileInfo m_info;
+  FilterNode * m_parent = nullptr;
+  int m_childIndex = 0;
+  bool m_matched = false;
+
+  std::vector<std::unique_ptr<FilterNode> > m_children;
+};
+
+enum EColumn
+{
+  NameColumn,
+  SizeColumn,
+  ModifiedColumn,
+  ColumnCount
+};
+
+} // namespace
+
+struct FilterModel::Impl
+{
+  std::unique_ptr<FilterNode> m_root;
+  QDir m_rootDir;
+  QRegExp m_regExp;
+  FilterScaner * m_scaner = nullptr;
+
+  /// relative path -> node, ancestors of a new match are resolved without walking the tree
+  QHash<QString, FilterNode *> m_pathIndex;
+};
+
+FilterModel::FilterModel(QObject * parent)
+  : TBase(parent)
+  , m_impl(new Impl())
+{
+}
+
+FilterModel::~FilterModel()
+{
+  cleanModel();
+  m_impl.reset();
+}
+
+void FilterModel::setFilter(CrawlRoot const & root, QRegExp const & regExp)
+{
+  beginResetModel();
+  cleanModel();
+  m_impl->m_regExp = regExp;
+
+  QFileInfo info(root.m_path);
+  if (!root.m_path.isEmpty() && info.exists() && !regExp.isEmpty() && regExp.isValid())
+  {
+    m_impl->m_rootDir = QDir(info.absoluteFilePath());
+    m_impl->m_root.reset(new FilterNode(info));
+
+    CrawlRoot scanRoot = root;
+    scanRoot.m_path = info.absoluteFilePath();
+    m_impl->m_scaner = new FilterScaner(scanRoot, regExp);
+    VERIFY(QObject::connect(m_impl->m_scaner, &FilterScaner::filesMatched,
+                            this, &FilterModel::filesMatched, Qt::QueuedConnection));
+    VERIFY(QObject::connect(m_impl->m_scaner, &FilterScaner::scanFinished,
+                            this, &FilterModel::scanFinished, Qt::QueuedConnection));
+    // deleted in scanFinished, so cancel() never touches a finished scaner
+    m_impl->m_scaner->setAutoDelete(false);
+    QThreadPool::globalInstance()->start(m_impl->m_scaner);
+  }
+  endResetModel();
+}
+
+void FilterModel::clearFilter()
+{
+  beginResetModel();
+  cleanModel();
+  m_impl->m_regExp = QRegExp();
+  endResetModel();
+}
+
+QRegExp const & FilterModel::filterRegExp() const
+{
+  return m_impl->m_regExp;
+}
+
+bool FilterModel::isDir(QModelIndex const & index) const
+{
+  FilterNode * node = static_cast<FilterNode *>(index.internalPointer());
+  if (node == nullptr)
+    return false;
+
+  return node->GetInfo().isDir();
+}
+
+bool FilterModel::isScanning() const
+{
+  return m_impl->m_scaner != nullptr;
+}
+
+int FilterModel::rowCount(QModelIndex const & parent) const
+{
+  if (!parent.isValid())
+    return m_impl->m_root ? 1 : 0;
+
+  if (parent.column() != 0)
+    return 0;
+
+  Q_ASSERT(parent.internalPointer() != nullptr);
+  FilterNode * node = static_cast<FilterNode *>(parent.internalPointer());
+  return node->GetChildCount();
+}
+
+int FilterModel::columnCount(QModelIndex const & /*parent*/) const
+{
+  return ColumnCount;
+}
+
+QModelIndex FilterModel::index(int row, int column, QModelIndex const & parent) const
+{
+  FilterNode * node = static_cast<FilterNode *>(parent.internalPointer());
+  if (node == nullptr)
+    return createIndex(row, column, m_impl->m_root.get());
+
+  return createIndex(row, column, node->GetChild(row));
+}
+
+QModelIndex FilterModel::parent(QModelIndex const & child) const
+{
+  FilterNode * childNode = static_cast<FilterNode *>(child.internalPointer());
+  if (childNode == nullptr)
+    return QModelIndex();
+
+  FilterNode * parent = childNode->GetParent();
+  if (parent == nullptr)
+    return QModelIndex();
+
+  return createIndex(parent->GetChildIndex(), 0, parent);
+}
+
+QVariant FilterModel::data(QModelIndex const & index, int role) const
+{
+  Q_ASSERT(index.internalPointer() != nullptr);
+  FilterNode * node = static_cast<FilterNode *>(index.internalPointer());
+  QFileInfo const & info = node->GetInfo();
+
+  if (role == Qt::DisplayRole)
+  {
+    switch (index.column())
+    {
+    case NameColumn:
+      return node->GetParent() == nullptr ? info.absoluteFilePath() : info.fileName();
+    case SizeColumn:
+      return info.isDir() ? QVariant() : QVariant(info.size());
+    case ModifiedColumn:
+      return info.lastModified();
+    }
+  }
+  else if (role == Qt::DecorationRole && index.column() == NameColumn)
+  {
+    static QIcon rootIcon(QStringLiteral(":/assets/root.png"));
+    static QIcon folderIcon(QStringLiteral(":/assets/folder.png"));
+    static QIcon fileIcon(QStringLiteral(":/assets/file.png"));
+
+    if (node->GetParent() == nullptr)
+      return rootIcon;
+    else if (info.isDir())
+      return folderIcon;
+
+    return fileIcon;
+  }
+  else if (role == Qt::ForegroundRole && !node->IsMatched())
+  {
+    // ancestors are kept only to show where the matches are
+    return QBrush(Qt::gray);
+  }
+
+  return QVariant();
+}
+
+QVariant FilterModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation == Qt::Vertical || role != Qt::DisplayRole)
+    return QVariant();
+
+  switch (section)
+  {
+  case NameColumn:
+    return QStringLiteral("Name");
+  case SizeColumn:
+    return QStringLiteral("Size");
+  case ModifiedColumn:
+    return QStringLiteral("Modified");
+  }
+
+  return QVariant();
+}
+
+Qt::ItemFlags FilterModel::flags(QModelIndex const & /*index*/) const
+{
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+void FilterModel::filesMatched(QStringList const & paths, FilterScaner * scaner)
+{
+  if (scaner != m_impl->m_scaner)
+    return;
+
+  Q_ASSERT(m_impl->m_root != nullptr);
+  for (QString const & path : paths)
+  {
+    QStringList parts = m_impl->m_rootDir.relativeFilePath(path).split('/', QString::SkipEmptyParts);
+    FilterNode * node = m_impl->m_root.get();
+    QString relativePath;
+
+    for (QString const & part : parts)
+    {
+      if (!relativePath.isEmpty())
+        relativePath.append('/');
+      relativePath.append(part);
+
+      FilterNode *& child = m_impl->m_pathIndex[relativePath];
+      if (child == nullptr)
+      {
+        int rowIndex = node->GetChildCount();
+        beginInsertRows(createIndex(node->GetChildIndex(), 0, node), rowIndex, rowIndex);
+        child = node->AddChild(QFileInfo(m_impl->m_rootDir.filePath(relativePath)));
+        endInsertRows();
+      }
+
+      node = child;
+    }
+
+    if (!node->IsMatched())
+    {
+      node->SetMatched();
+      QModelIndex index = createIndex(node->GetChildIndex(), 0, node);
+      emit dataChanged(index, index, QVector<int>{ Qt::ForegroundRole });
+    }
+  }
+}
+
+void FilterModel::scanFinished(FilterScaner * scaner)
+{
+  if (scaner == m_impl->m_scaner)
+    m_impl->m_scaner = nullptr;
+
+  scaner->deleteLater();
+}
+
+void FilterModel::cleanModel()
+{
+  if (m_impl->m_scaner != nullptr)
+    m_impl->m_scaner->cancel();
+
+  m_impl->m_scaner = nullptr;
+  m_impl->m_pathIndex.clear();
+  m_impl->m_root.reset();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QAbstractItemModel>
+#include <QRegExp>
+
+class FilterScaner;
+struct CrawlRoot;
+
+/// Tree of the entries under a root whose names match a pattern.
+/// Only matches and the ancestor chain of every match are kept, the subtree is
+/// searched on disk by a background FilterScaner and hits are inserted as they come.
+class FilterModel : public QAbstractItemModel
+{
+  using TBase = QAbstractItemModel;
+public:
+  FilterModel(QObject * parent = 0);
+  ~FilterModel();
+
+  /// The path and exclusion rules of root limit the search
+  void setFilter(CrawlRoot const & root, QRegExp const & regExp);
+  void clearFilter();
+
+  QRegExp const & filterRegExp() const;
+  bool isDir(QModelIndex const & index) const;
+  bool isScanning() const;
+
+  int rowCount(QModelIndex const & parent) const override;
+  int columnCount(QModelIndex const & parent) const override;
+
+  QModelIndex index(int row, int column, QModelIndex const & parent) const override;
+  QModelIndex parent(QModelIndex const & child) const override;
+  QVariant data(QModelIndex const & index, int role) const override;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+  Qt::ItemFlags flags(QModelIndex const & index) const override;
+
+private:
+  Q_SLOT void filesMatched(QStringList const & paths, FilterScaner * scaner);
+  Q_SLOT void scanFinished(FilterScaner * scaner);
+
+  void cleanModel();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+};
@@ -0,0 +1,112 @@
+#include "filter_scaner.hpp"
+#include "file_stat.hpp"
+
+#include <QElapsedTimer>
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+int const BatchSize = 256;
+qint64 const BatchTimeout = 100;
+
+struct Dir
+{
+  std::unique_ptr<DirLister> m_lister;
+  /// ends with a separator
+  QString m_path;
+  QString m_relativePath;
+  TIgnoreRules m_rules;
+};
+
+} // namespace
+
+FilterScaner::FilterScaner(CrawlRoot const & root, QRegExp const & regExp)
+  : m_root(root)
+  , m_pattern(regExp.pattern())
+  , m_caseSensitivity(regExp.caseSensitivity())
+  , m_syntax(regExp.patternSyntax())
+  , m_canceled(false)
+{
+}
+
+void FilterScaner::run()
+{
+  // own instance, QRegExp keeps match state and must not be shared between threads
+  QRegExp regExp(m_pattern, m_caseSensitivity, m_syntax);
+
+  QStringList matched;
+  QElapsedTimer timer;
+  timer.start();
+
+  // open directories, the deepest is listed first
+  std::vector<Dir> dirs;
+  auto openDir = [this, &dirs](QString const & path, QString const & relativePath, TIgnoreRules const & rules)
+  {
+    Dir dir;
+    dir.m_lister.reset(new DirLister(path));
+    dir.m_path = path.endsWith('/') ? path : path + '/';
+    dir.m_relativePath = relativePath;
+    dir.m_rules = m_root.m_readGitIgnore ? ReadGitIgnore(rules, path, relativePath) : rules;
+    dirs.push_back(std::move(dir));
+  };
+  openDir(m_root.m_path, m_root.m_relativePath, m_root.m_rules);
+
+  ListedEntry listed;
+  while (!dirs.empty())
+  {
+    if (m_canceled == true)
+      break;
+
+    Dir & dir = dirs.back();
+    if (!dir.m_lister->Next(listed))
+    {
+      dirs.pop_back();
+      continue;
+    }
+
+    // the same entries the scaners list
+    if (listed.m_isHidden || listed.m_isDangling)
+      continue;
+
+    QString const fileName = QString::fromRawData(listed.m_name, listed.m_nameLength);
+    bool const isDir = listed.m_stat.m_isDir;
+    // an excluded directory is never opened, so nothing below it is read
+    if (dir.m_rules != nullptr && dir.m_rules->IsExcluded(dir.m_relativePath, fileName, isDir))
+      continue;
+
+    bool const isMatched = regExp.indexIn(fileName) != -1;
+    bool const isListed = isDir && !listed.m_isSymLink;
+    if (isMatched || isListed)
+    {
+      QString const filePath = dir.m_path + fileName;
+      if (isMatched)
+        matched.append(filePath);
+      if (isListed)
+      {
+        QString const relativePath = dir.m_relativePath.isEmpty() ? fileName : dir.m_relativePath + '/' + fileName;
+        TIgnoreRules const rules = dir.m_rules;
+        openDir(filePath, relativePath, rules);
+      }
+    }
+
+    if (matched.size() >= BatchSize || (!matched.isEmpty() && timer.elapsed() > BatchTimeout))
+    {
+      emit filesMatched(matched, this);
+      matched.clear();
+      timer.restart();
+    }
+  }
+
+  if (!matched.isEmpty() && m_canceled == false)
+    emit filesMatched(matched, this);
+
+  emit scanFinished(this);
+}
+
+void FilterScaner::cancel()
+{
+  m_canceled = true;
+}
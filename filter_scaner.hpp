@@ -0,0 +1,34 @@
+#pragma once
+
+#include "parallel_crawler.hpp"
+
+#include <QObject>
+#include <QRunnable>
+#include <QRegExp>
+#include <QStringList>
+#include <atomic>
+
+class FilterScaner : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  /// Excluded subtrees of root are never read, the same as the scaners of the model prune them
+  FilterScaner(CrawlRoot const & root, QRegExp const & regExp);
+
+  /// Matches are reported in batches to keep the queued connection cheap
+  Q_SIGNAL void filesMatched(QStringList const & paths, FilterScaner * scaner);
+  Q_SIGNAL void scanFinished(FilterScaner * scaner);
+
+  void cancel();
+
+protected:
+  void run();
+
+private:
+  CrawlRoot m_root;
+  QString m_pattern;
+  Qt::CaseSensitivity m_caseSensitivity;
+  QRegExp::PatternSyntax m_syntax;
+  std::atomic<bool> m_canceled;
+};
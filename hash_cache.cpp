@@ -0,0 +1,149 @@
+#include "hash_cache.hpp"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+quint32 const CacheMagic = 0x4C464843;
+quint32 const CacheVersion = 1;
+/// About 60 MB on disk
+int const MaxRecordCount = 1000 * 1000;
+
+} // namespace
+
+bool operator == (HashKey const & l, HashKey const & r)
+{
+  return l.m_device == r.m_device && l.m_inode == r.m_inode && l.m_size == r.m_size &&
+         l.m_modifiedTime == r.m_modifiedTime && l.m_algorithm == r.m_algorithm;
+}
+
+uint qHash(HashKey const & key, uint seed)
+{
+  return ::qHash(key.m_inode, seed) ^ ::qHash(key.m_modifiedTime, seed) ^
+         ::qHash(key.m_device ^ static_cast<quint64>(key.m_size) ^ key.m_algorithm, seed);
+}
+
+HashCache::HashCache(QString const & path)
+  : m_path(path)
+{
+}
+
+bool HashCache::Find(HashKey const & key, QByteArray & hash)
+{
+  QMutexLocker lock(&m_mutex);
+  Load();
+
+  QHash<HashKey, Record>::iterator it = m_records.find(key);
+  if (it == m_records.end())
+    return false;
+
+  it->m_lastUse = ++m_tick;
+  hash = it->m_hash;
+  return true;
+}
+
+void HashCache::Insert(HashKey const & key, QByteArray const & hash)
+{
+  QMutexLocker lock(&m_mutex);
+  Load();
+
+  Record & record = m_records[key];
+  record.m_hash = hash;
+  record.m_lastUse = ++m_tick;
+  m_isChanged = true;
+}
+
+bool HashCache::Save(QString & error)
+{
+  QMutexLocker lock(&m_mutex);
+  if (!m_isChanged)
+    return true;
+
+  std::vector<QHash<HashKey, Record>::const_iterator> records;
+  records.reserve(m_records.size());
+  for (QHash<HashKey, Record>::const_iterator it = m_records.constBegin(); it != m_records.constEnd(); ++it)
+    records.push_back(it);
+
+  if (records.size() > static_cast<size_t>(MaxRecordCount))
+  {
+    std::nth_element(records.begin(), records.begin() + MaxRecordCount, records.end(),
+                     [](QHash<HashKey, Record>::const_iterator l, QHash<HashKey, Record>::const_iterator r)
+    {
+      return l->m_lastUse > r->m_lastUse;
+    });
+    records.resize(MaxRecordCount);
+  }
+
+  QSaveFile file(m_path);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  // records are written in use order, so loading them restores the order as well
+  std::sort(records.begin(), records.end(),
+            [](QHash<HashKey, Record>::const_iterator l, QHash<HashKey, Record>::const_iterator r)
+  {
+    return l->m_lastUse < r->m_lastUse;
+  });
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << CacheMagic << CacheVersion << static_cast<quint32>(records.size());
+  for (QHash<HashKey, Record>::const_iterator it : records)
+  {
+    HashKey const & key = it.key();
+    stream << key.m_device << key.m_inode << key.m_size << key.m_modifiedTime << key.m_algorithm << it->m_hash;
+  }
+
+  if (stream.status() != QDataStream::Ok || !file.commit())
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  m_isChanged = false;
+  return true;
+}
+
+void HashCache::Load()
+{
+  if (m_isLoaded)
+    return;
+
+  // a missing or damaged cache only costs rehashing
+  m_isLoaded = true;
+  QFile file(m_path);
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  quint32 count = 0;
+  stream >> magic >> version >> count;
+  if (magic != CacheMagic || version != CacheVersion)
+    return;
+
+  m_records.reserve(static_cast<int>(std::min<quint32>(count, MaxRecordCount)));
+  for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    HashKey key;
+    Record record;
+    stream >> key.m_device >> key.m_inode >> key.m_size >> key.m_modifiedTime >> key.m_algorithm >> record.m_hash;
+    if (stream.status() != QDataStream::Ok)
+      break;
+
+    record.m_lastUse = ++m_tick;
+    m_records.insert(key, record);
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+/// Identity of file content: the same inode with the same size and modification time
+/// is assumed to hold the same bytes
+struct HashKey
+{
+  quint64 m_device = 0;
+  quint64 m_inode = 0;
+  qint64 m_size = 0;
+  qint64 m_modifiedTime = 0;
+  quint8 m_algorithm = 0;
+};
+
+bool operator == (HashKey const & l, HashKey const & r);
+uint qHash(HashKey const & key, uint seed = 0);
+
+/// Content hashes kept across runs, shared by all hashing threads
+class HashCache
+{
+public:
+  explicit HashCache(QString const & path);
+
+  /// The file is read on the first lookup, so a pool thread pays for it
+  bool Find(HashKey const & key, QByteArray & hash);
+  void Insert(HashKey const & key, QByteArray const & hash);
+  /// Writes the cache back when something was added, least recently used hashes
+  /// beyond the limit are dropped
+  bool Save(QString & error);
+
+private:
+  void Load();
+
+  struct Record
+  {
+    QByteArray m_hash;
+    quint64 m_lastUse = 0;
+  };
+
+  QMutex m_mutex;
+  QString m_path;
+  bool m_isLoaded = false;
+  bool m_isChanged = false;
+  quint64 m_tick = 0;
+  QHash<HashKey, Record> m_records;
+};
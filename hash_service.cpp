@@ -0,0 +1,343 @@
+#include "hash_service.hpp"
+#include "file_stat.hpp"
+#include "hash_cache.hpp"
+#include "macros.hpp"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QMutex>
+
+#include <cstring>
+#include <deque>
+
+namespace
+{
+
+/// Hashing is bound by the disk, more threads only make a spinning one seek
+int const HashThreadCount = 2;
+qint64 const ReadBlockSize = 1024 * 1024;
+
+/// A few screens of rows, older requests are for rows scrolled past
+size_t const MaxPaintedRequests = 256;
+
+/// Streaming XXH64 with seed 0
+class Xxh64
+{
+public:
+  void Update(uchar const * data, size_t size)
+  {
+    m_totalSize += size;
+    if (m_bufferSize + size < sizeof(m_buffer))
+    {
+      std::memcpy(m_buffer + m_bufferSize, data, size);
+      m_bufferSize += size;
+      return;
+    }
+
+    if (m_bufferSize > 0)
+    {
+      size_t const fill = sizeof(m_buffer) - m_bufferSize;
+      std::memcpy(m_buffer + m_bufferSize, data, fill);
+      Consume(m_buffer);
+      data += fill;
+      size -= fill;
+      m_bufferSize = 0;
+    }
+
+    for (; size >= sizeof(m_buffer); data += sizeof(m_buffer), size -= sizeof(m_buffer))
+      Consume(data);
+
+    std::memcpy(m_buffer, data, size);
+    m_bufferSize = size;
+  }
+
+  /// Big endian, the canonical form other tools print
+  QByteArray Digest() const
+  {
+    quint64 hash = Prime5;
+    if (m_totalSize >= sizeof(m_buffer))
+    {
+      hash = Rotl(m_acc[0], 1) + Rotl(m_acc[1], 7) + Rotl(m_acc[2], 12) + Rotl(m_acc[3], 18);
+      for (quint64 acc : m_acc)
+        hash = (hash ^ Round(0, acc)) * Prime1 + Prime4;
+    }
+
+    hash += m_totalSize;
+    uchar const * p = m_buffer;
+    uchar const * end = m_buffer + m_bufferSize;
+    for (; p + 8 <= end; p += 8)
+      hash = Rotl(hash ^ Round(0, Read64(p)), 27) * Prime1 + Prime4;
+    if (p + 4 <= end)
+    {
+      hash = Rotl(hash ^ Read32(p) * Prime1, 23) * Prime2 + Prime3;
+      p += 4;
+    }
+    for (; p < end; ++p)
+      hash = Rotl(hash ^ *p * Prime5, 11) * Prime1;
+
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+
+    QByteArray digest(8, '\0');
+    for (int i = 0; i < 8; ++i)
+      digest[i] = static_cast<char>(hash >> (56 - 8 * i));
+    return digest;
+  }
+
+private:
+  static quint64 const Prime1 = 11400714785074694791ULL;
+  static quint64 const Prime2 = 14029467366897019727ULL;
+  static quint64 const Prime3 = 1609587929392839161ULL;
+  static quint64 const Prime4 = 9650029242287828579ULL;
+  static quint64 const Prime5 = 2870177450012600261ULL;
+
+  static quint64 Rotl(quint64 value, int bits)
+  {
+    return value << bits | value >> (64 - bits);
+  }
+
+  static quint64 Round(quint64 acc, quint64 input)
+  {
+    return Rotl(acc + input * Prime2, 31) * Prime1;
+  }
+
+  static quint64 Read32(uchar const * p)
+  {
+    return static_cast<quint64>(p[0]) | static_cast<quint64>(p[1]) << 8 |
+           static_cast<quint64>(p[2]) << 16 | static_cast<quint64>(p[3]) << 24;
+  }
+
+  static quint64 Read64(uchar const * p)
+  {
+    return Read32(p) | Read32(p + 4) << 32;
+  }
+
+  void Consume(uchar const * p)
+  {
+    for (int i = 0; i < 4; ++i)
+      m_acc[i] = Round(m_acc[i], Read64(p + 8 * i));
+  }
+
+  quint64 m_acc[4] = { Prime1 + Prime2, Prime2, 0, 0 - Prime1 };
+  uchar m_buffer[32];
+  size_t m_bufferSize = 0;
+  quint64 m_totalSize = 0;
+};
+
+} // namespace
+
+/// Requests shared by the service and its workers, everything is guarded by m_mutex
+struct HashQueue
+{
+  HashQueue()
+    : m_canceled(std::make_shared<std::atomic<bool> >(false))
+  {
+  }
+
+  QMutex m_mutex;
+  /// newest at the back
+  std::deque<QString> m_painted;
+  std::deque<QString> m_kept;
+  HashService::EAlgorithm m_algorithm = HashService::Xxh64;
+  /// replaced by clear, running hashes see the old one set
+  std::shared_ptr<std::atomic<bool> > m_canceled;
+  std::shared_ptr<HashCache> m_cache;
+};
+
+HashService::HashService(QObject * parent)
+  : QObject(parent)
+  , m_queue(std::make_shared<HashQueue>())
+{
+  m_queue->m_cache = std::make_shared<HashCache>(QStringLiteral("hashes.cache"));
+  m_pool.setMaxThreadCount(HashThreadCount);
+  for (int i = 0; i < HashThreadCount; ++i)
+  {
+    m_workers.emplace_back(new HashWorker(*m_queue));
+    m_workers.back()->setAutoDelete(false);
+    VERIFY(QObject::connect(m_workers.back().get(), &HashWorker::hashFinished,
+                            this, &HashService::hashFinished, Qt::QueuedConnection));
+  }
+}
+
+HashService::~HashService()
+{
+  clear();
+  m_pool.waitForDone();
+
+  QString error;
+  m_queue->m_cache->Save(error);
+}
+
+void HashService::setAlgorithm(EAlgorithm algorithm)
+{
+  QMutexLocker lock(&m_queue->m_mutex);
+  m_queue->m_algorithm = algorithm;
+}
+
+HashService::EAlgorithm HashService::algorithm() const
+{
+  QMutexLocker lock(&m_queue->m_mutex);
+  return m_queue->m_algorithm;
+}
+
+void HashService::request(QString const & path, bool isKept)
+{
+  QString dropped;
+  HashWorker * idle = nullptr;
+  {
+    QMutexLocker lock(&m_queue->m_mutex);
+    if (isKept)
+      m_queue->m_kept.push_back(path);
+    else
+    {
+      m_queue->m_painted.push_back(path);
+      if (m_queue->m_painted.size() > MaxPaintedRequests)
+      {
+        dropped = m_queue->m_painted.front();
+        m_queue->m_painted.pop_front();
+      }
+    }
+
+    // a worker clears its flag under the same lock when it finds the queue empty
+    for (std::unique_ptr<HashWorker> const & worker : m_workers)
+    {
+      if (!worker->m_isRunning)
+      {
+        worker->m_isRunning = true;
+        idle = worker.get();
+        break;
+      }
+    }
+  }
+
+  if (idle != nullptr)
+    m_pool.start(idle);
+  if (!dropped.isNull())
+    emit hashDropped(dropped);
+}
+
+void HashService::clear()
+{
+  QMutexLocker lock(&m_queue->m_mutex);
+  m_queue->m_painted.clear();
+  m_queue->m_kept.clear();
+  *m_queue->m_canceled = true;
+  m_queue->m_canceled = std::make_shared<std::atomic<bool> >(false);
+}
+
+void HashService::hashFinished(QString const & path, QByteArray const & hash, QString const & error)
+{
+  if (hash.isEmpty() && error.isEmpty())
+    return;
+
+  if (hash.isEmpty())
+    emit hashFailed(path, error);
+  else
+    emit hashReady(path, hash);
+}
+
+HashWorker::HashWorker(HashQueue & queue)
+  : m_queue(queue)
+  , m_buffer(ReadBlockSize)
+{
+}
+
+void HashWorker::run()
+{
+  for (;;)
+  {
+    QString path;
+    HashService::EAlgorithm algorithm;
+    std::shared_ptr<std::atomic<bool> > canceled;
+    {
+      QMutexLocker lock(&m_queue.m_mutex);
+      // the rows painted last are the ones the user looks at
+      if (!m_queue.m_painted.empty())
+      {
+        path = m_queue.m_painted.back();
+        m_queue.m_painted.pop_back();
+      }
+      else if (!m_queue.m_kept.empty())
+      {
+        path = m_queue.m_kept.front();
+        m_queue.m_kept.pop_front();
+      }
+      else
+      {
+        m_isRunning = false;
+        return;
+      }
+
+      algorithm = m_queue.m_algorithm;
+      canceled = m_queue.m_canceled;
+    }
+
+    Hash(path, algorithm, *canceled);
+  }
+}
+
+void HashWorker::Hash(QString const & path, HashService::EAlgorithm algorithm, std::atomic<bool> const & canceled)
+{
+  FileStat stat;
+  if (!ReadFileStat(path, stat))
+  {
+    emit hashFinished(path, QByteArray(), QStringLiteral("Cannot read %1").arg(path));
+    return;
+  }
+
+  HashKey key;
+  key.m_device = stat.m_device;
+  key.m_inode = stat.m_inode;
+  key.m_size = stat.m_size;
+  key.m_modifiedTime = stat.m_modifiedTime;
+  key.m_algorithm = static_cast<quint8>(algorithm);
+
+  QByteArray hash;
+  if (m_queue.m_cache->Find(key, hash))
+  {
+    emit hashFinished(path, hash, QString());
+    return;
+  }
+
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    emit hashFinished(path, QByteArray(), file.errorString());
+    return;
+  }
+
+  Xxh64 xxh64;
+  QCryptographicHash sha256(QCryptographicHash::Sha256);
+  for (;;)
+  {
+    if (canceled == true)
+      return;
+
+    qint64 const count = file.read(m_buffer.data(), ReadBlockSize);
+    if (count < 0)
+    {
+      emit hashFinished(path, QByteArray(), file.errorString());
+      return;
+    }
+
+    if (count == 0)
+      break;
+
+    if (algorithm == HashService::Xxh64)
+      xxh64.Update(reinterpret_cast<uchar const *>(m_buffer.data()), static_cast<size_t>(count));
+    else
+      sha256.addData(m_buffer.data(), static_cast<int>(count));
+  }
+
+  hash = algorithm == HashService::Xxh64 ? xxh64.Digest() : sha256.result();
+
+  // the file may have changed while it was read, such a hash is shown but not kept
+  FileStat after;
+  if (ReadFileStat(path, after) && after == stat)
+    m_queue.m_cache->Insert(key, hash);
+
+  emit hashFinished(path, hash, QString());
+}
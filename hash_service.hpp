@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class HashCache;
+class HashWorker;
+struct HashQueue;
+
+/// Hashes file content on its own small pool, results of unchanged files come from HashCache.
+/// A fixed set of workers takes the requests from a shared queue.
+class HashService : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum EAlgorithm
+  {
+    /// XXH64, fast enough to be limited by the disk
+    Xxh64,
+    Sha256
+  };
+
+  HashService(QObject * parent = 0);
+  /// Waits for running workers and writes the cache back
+  ~HashService();
+
+  void setAlgorithm(EAlgorithm algorithm);
+  EAlgorithm algorithm() const;
+
+  /// Requests of painted rows run newest first. Only the newest few are kept, rows scrolled
+  /// past long ago are dropped with hashDropped. Kept requests are never dropped and run
+  /// after the painted ones.
+  void request(QString const & path, bool isKept = false);
+  /// Drops queued and running requests without a signal
+  void clear();
+
+  Q_SIGNAL void hashReady(QString const & path, QByteArray const & hash);
+  Q_SIGNAL void hashFailed(QString const & path, QString const & error);
+  /// Not hashed, the path may be requested again
+  Q_SIGNAL void hashDropped(QString const & path);
+
+private:
+  Q_SLOT void hashFinished(QString const & path, QByteArray const & hash, QString const & error);
+
+private:
+  QThreadPool m_pool;
+  std::shared_ptr<HashQueue> m_queue;
+  std::vector<std::unique_ptr<HashWorker> > m_workers;
+};
+
+/// Hashes queued paths until the queue is empty, started again by the next request
+class HashWorker : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  explicit HashWorker(HashQueue & queue);
+
+  /// error is set when the file could not be read, canceled requests are not reported
+  Q_SIGNAL void hashFinished(QString const & path, QByteArray const & hash, QString const & error);
+
+protected:
+  void run();
+
+private:
+  friend class HashService;
+
+  void Hash(QString const & path, HashService::EAlgorithm algorithm, std::atomic<bool> const & canceled);
+
+  HashQueue & m_queue;
+  /// guarded by the mutex of the queue, set by the service when it starts the worker
+  bool m_isRunning = false;
+  /// read buffer of every file the worker hashes
+  std::vector<char> m_buffer;
+};
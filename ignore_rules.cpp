@@ -0,0 +1,282 @@
+#include "ignore_rules.hpp"
+
+#include <QFile>
+
+#include <algorithm>
+
+namespace
+{
+
+bool HasWildcards(QString const & pattern)
+{
+  for (QChar const c : pattern)
+  {
+    if (c == '*' || c == '?' || c == '[' || c == '\\')
+      return true;
+  }
+
+  return false;
+}
+
+/// [abc], [a-z] and [!a-z] at p, matched is set when the class is well formed.
+/// Returns the position behind the closing bracket.
+QChar const * MatchClass(QChar const * p, QChar const * pe, QChar c, bool & matched, bool & isValid)
+{
+  QChar const * q = p + 1;
+  bool const isNegated = q != pe && (*q == '!' || *q == '^');
+  if (isNegated)
+    ++q;
+
+  bool isIn = false;
+  QChar const * first = q;
+  while (q != pe && (*q != ']' || q == first))
+  {
+    if (q + 2 < pe && q[1] == '-' && q[2] != ']')
+    {
+      if (c >= q[0] && c <= q[2])
+        isIn = true;
+      q += 3;
+    }
+    else
+    {
+      if (c == *q)
+        isIn = true;
+      ++q;
+    }
+  }
+
+  isValid = q != pe;
+  matched = isIn != isNegated && c != '/';
+  return q + 1;
+}
+
+/// '*' and '?' never match a slash, "**" matches across directories and "**/" matches none as well
+bool GlobMatch(QChar const * p, QChar const * pe, QChar const * s, QChar const * se)
+{
+  while (p != pe)
+  {
+    QChar const c = *p;
+    if (c == '*')
+    {
+      bool const isDeep = p + 1 != pe && p[1] == '*';
+      p += isDeep ? 2 : 1;
+      if (isDeep && p != pe && *p == '/' && GlobMatch(p + 1, pe, s, se))
+        return true;
+
+      if (p == pe)
+        return isDeep || std::find(s, se, QChar('/')) == se;
+
+      for (; s != se; ++s)
+      {
+        if (GlobMatch(p, pe, s, se))
+          return true;
+        if (!isDeep && *s == '/')
+          return false;
+      }
+
+      return false;
+    }
+
+    if (s == se)
+      return false;
+
+    if (c == '?')
+    {
+      if (*s == '/')
+        return false;
+      ++p;
+      ++s;
+      continue;
+    }
+
+    if (c == '[')
+    {
+      bool matched = false;
+      bool isValid = false;
+      QChar const * next = MatchClass(p, pe, *s, matched, isValid);
+      if (isValid)
+      {
+        if (!matched)
+          return false;
+        p = next;
+        ++s;
+        continue;
+      }
+      // unterminated class is a plain bracket
+    }
+
+    if (c == '\\' && p + 1 != pe)
+      ++p;
+
+    if (*p != *s)
+      return false;
+    ++p;
+    ++s;
+  }
+
+  return s == se;
+}
+
+bool GlobMatch(QString const & pattern, QString const & text)
+{
+  return GlobMatch(pattern.constData(), pattern.constData() + pattern.size(),
+                   text.constData(), text.constData() + text.size());
+}
+
+} // namespace
+
+IgnoreRules::IgnoreRules(std::shared_ptr<IgnoreRules const> const & parent, QString const & basePath,
+                         QStringList const & lines)
+  : m_parent(parent)
+  , m_basePath(basePath)
+{
+  for (QString line : lines)
+  {
+    if (line.endsWith('\r'))
+      line.chop(1);
+
+    // trailing spaces are dropped unless escaped
+    while (line.endsWith(' ') && !line.endsWith("\\ "))
+      line.chop(1);
+
+    if (line.isEmpty() || line.startsWith('#'))
+      continue;
+
+    Rule rule;
+    if (line.startsWith('!'))
+    {
+      rule.m_isNegated = true;
+      line.remove(0, 1);
+    }
+    else if (line.startsWith("\\!") || line.startsWith("\\#"))
+      line.remove(0, 1);
+
+    if (line.endsWith('/'))
+    {
+      rule.m_isDirOnly = true;
+      line.chop(1);
+    }
+
+    // "**/name" is the same as a plain name
+    while (line.startsWith("**/") && line.indexOf('/', 3) < 0)
+      line.remove(0, 3);
+
+    if (line.startsWith('/'))
+    {
+      rule.m_isAnchored = true;
+      line.remove(0, 1);
+    }
+    else
+      rule.m_isAnchored = line.contains('/');
+
+    if (line.isEmpty())
+      continue;
+
+    int const index = static_cast<int>(m_rules.size());
+    if (!rule.m_isAnchored && !HasWildcards(line))
+    {
+      rule.m_kind = Rule::Literal;
+      m_literals[line].append(index);
+    }
+    else
+    {
+      if (!rule.m_isAnchored && line.startsWith('*') && !HasWildcards(line.mid(1)))
+      {
+        rule.m_kind = Rule::Suffix;
+        line.remove(0, 1);
+      }
+      m_others.push_back(index);
+    }
+
+    rule.m_pattern = line;
+    m_rules.push_back(rule);
+  }
+}
+
+bool IgnoreRules::IsExcluded(QString const & dirPath, QString const & name, bool isDir) const
+{
+  // the deepest set that has an opinion decides
+  for (IgnoreRules const * rules = this; rules != nullptr; rules = rules->m_parent.get())
+  {
+    int const index = rules->FindMatch(dirPath, name, isDir);
+    if (index >= 0)
+      return !rules->m_rules[index].m_isNegated;
+  }
+
+  return false;
+}
+
+bool IgnoreRules::IsEmpty() const
+{
+  return m_rules.empty();
+}
+
+int IgnoreRules::FindMatch(QString const & dirPath, QString const & name, bool isDir) const
+{
+  // the last matching rule wins, so only rules behind a literal hit are worth testing
+  int match = -1;
+  QHash<QString, QVector<int> >::const_iterator literal = m_literals.constFind(name);
+  if (literal != m_literals.constEnd())
+  {
+    for (int i = literal->size() - 1; i >= 0 && match < 0; --i)
+    {
+      if (isDir || !m_rules[literal->at(i)].m_isDirOnly)
+        match = literal->at(i);
+    }
+  }
+
+  QString relativePath;
+  bool hasRelativePath = false;
+  for (auto it = m_others.rbegin(); it != m_others.rend() && *it > match; ++it)
+  {
+    Rule const & rule = m_rules[*it];
+    if (rule.m_isDirOnly && !isDir)
+      continue;
+
+    if (rule.m_isAnchored && !hasRelativePath)
+    {
+      // path of the entry below the directory these rules came from
+      QString const dir = m_basePath.isEmpty() ? dirPath : dirPath.mid(m_basePath.size() + 1);
+      relativePath = dir.isEmpty() ? name : dir + '/' + name;
+      hasRelativePath = true;
+    }
+
+    if (Matches(rule, relativePath, name))
+      return *it;
+  }
+
+  return match;
+}
+
+bool IgnoreRules::Matches(Rule const & rule, QString const & relativePath, QString const & name) const
+{
+  if (rule.m_isAnchored)
+    return GlobMatch(rule.m_pattern, relativePath);
+
+  switch (rule.m_kind)
+  {
+  case Rule::Literal:
+    return name == rule.m_pattern;
+  case Rule::Suffix:
+    return name.endsWith(rule.m_pattern);
+  case Rule::Glob:
+    return GlobMatch(rule.m_pattern, name);
+  }
+
+  return false;
+}
+
+TIgnoreRules ReadGitIgnore(TIgnoreRules const & parent, QString const & dirPath, QString const & relativePath)
+{
+  // a failed open is the only cost for directories without the file
+  QFile file(dirPath + "/.gitignore");
+  if (!file.open(QIODevice::ReadOnly))
+    return parent;
+
+  QStringList const lines = QString::fromUtf8(file.readAll()).split('\n');
+  std::shared_ptr<IgnoreRules> rules = std::make_shared<IgnoreRules>(parent, relativePath, lines);
+  if (rules->IsEmpty())
+    return parent;
+
+  return rules;
+}
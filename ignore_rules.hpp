@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QHash>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+/// Compiled gitignore style rules of one source: global rules, rules of a root or a .gitignore file.
+/// Sets are chained, the set of a deeper directory is asked first and falls back to its parent.
+/// Immutable after construction, so scaners share them between threads.
+class IgnoreRules
+{
+public:
+  /// basePath is the directory the rules are relative to, relative to the scanned root, "" for the root
+  IgnoreRules(std::shared_ptr<IgnoreRules const> const & parent, QString const & basePath, QStringList const & lines);
+
+  /// dirPath is the directory of the entry relative to the scanned root
+  bool IsExcluded(QString const & dirPath, QString const & name, bool isDir) const;
+
+  /// No rules of its own, the parent is not looked at
+  bool IsEmpty() const;
+
+private:
+  struct Rule
+  {
+    enum EKind
+    {
+      /// name without wildcards
+      Literal,
+      /// "*.ext"
+      Suffix,
+      Glob
+    };
+
+    QString m_pattern;
+    EKind m_kind = Glob;
+    bool m_isNegated = false;
+    bool m_isDirOnly = false;
+    /// has a slash, matched against the path relative to the base instead of the name
+    bool m_isAnchored = false;
+  };
+
+  /// Index of the last rule of this set that matches, -1 when none does
+  int FindMatch(QString const & dirPath, QString const & name, bool isDir) const;
+  bool Matches(Rule const & rule, QString const & relativePath, QString const & name) const;
+
+  std::shared_ptr<IgnoreRules const> m_parent;
+  QString m_basePath;
+  std::vector<Rule> m_rules;
+
+  /// positions of Literal rules by name, the common case is a single hash lookup
+  QHash<QString, QVector<int> > m_literals;
+  /// positions of all other rules, ascending
+  std::vector<int> m_others;
+};
+
+/// Entries left out of the listing, everything below a pruned directory is never read
+struct PruneCount
+{
+  quint64 m_files = 0;
+  quint64 m_dirs = 0;
+};
+
+Q_DECLARE_METATYPE(PruneCount)
+
+using TIgnoreRules = std::shared_ptr<IgnoreRules const>;
+
+Q_DECLARE_METATYPE(TIgnoreRules)
+
+/// Rules of the .gitignore file in dirPath chained to parent, parent itself when there is no such file
+TIgnoreRules ReadGitIgnore(TIgnoreRules const & parent, QString const & dirPath, QString const & relativePath);
@@ -1,30 +1,58 @@
 #include "mainwindow.hpp"
 #include "ui_mainwindow.h"
 
+#include "diff_model.hpp"
+#include "exporter.hpp"
+#include "file_operation_queue.hpp"
 #include "macros.hpp"
+#include "parallel_crawler.hpp"
 #include "proxy_item_delegate.hpp"
 #include "reg_exp_dialog.hpp"
+#include "snapshot_diff.hpp"
+#include "stats_panel.hpp"
 
+#include <QDir>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QMessageBox>
 #include <QSettings>
+#include <QSignalBlocker>
+#include <QTabBar>
+#include <QThreadPool>
+#include <QTreeView>
+#include <QVBoxLayout>
 
 MainWindow::MainWindow(QWidget *parent)
   : QMainWindow(parent)
   , m_ui(new Ui::MainWindow)
+  , m_rootTabs(nullptr)
+  , m_exporter(nullptr)
+  , m_operationQueue(nullptr)
+  , m_statsPanel(nullptr)
+  , m_crawler(nullptr)
+  , m_useGitIgnore(true)
   , m_ignoreTableSelection(false)
 {
   m_fileModel = new FileSystemModel(this);
+  m_filterModel = new FilterModel(this);
+  m_operationQueue = new FileOperationQueue(this);
   m_model = new QSortFilterProxyModel(m_fileModel);
   m_model->setSourceModel(m_fileModel);
 
   m_ui->setupUi(this);
 
-  m_ui->m_fileTree->setModel(m_model);
-
-  for (int i = 1; i < m_model->columnCount(QModelIndex()); ++i)
-    m_ui->m_fileTree->hideColumn(i);
+  // switching tabs only moves the views, every root stays loaded in the shared tree
+  m_rootTabs = new QTabBar(this);
+  m_rootTabs->setTabsClosable(true);
+  m_rootTabs->setExpanding(false);
+  m_rootTabs->setDocumentMode(true);
+  m_ui->verticalLayout->insertWidget(1, m_rootTabs);
+  VERIFY(QObject::connect(m_rootTabs, &QTabBar::currentChanged, this, &MainWindow::onRootTabChanged));
+  VERIFY(QObject::connect(m_rootTabs, &QTabBar::tabCloseRequested, this, &MainWindow::onRootTabClosed));
 
+  m_ui->m_fileTree->setModel(m_model);
   m_ui->m_fileTable->setModel(m_model);
+  SetSourceModel(m_fileModel);
 
   QAbstractItemDelegate * proxyDelegate = new ProxyItemDelegate(m_ui->m_fileTable->itemDelegate(), m_ui->m_fileTable);
   m_ui->m_fileTable->setItemDelegate(proxyDelegate);
@@ -51,17 +79,114 @@ MainWindow::MainWindow(QWidget *parent)
   VERIFY(QObject::connect(m_ui->m_fileTable->selectionModel(), &QItemSelectionModel::selectionChanged,
                           this, &MainWindow::onTableSelectionChanged));
 
+  VERIFY(QObject::connect(m_ui->m_fileTree, &QTreeView::expanded, this, &MainWindow::onTreeExpanded));
+  VERIFY(QObject::connect(m_ui->m_fileTree, &QTreeView::collapsed, this, &MainWindow::onTreeCollapsed));
+
   QAction * regExpAction = new QAction(QStringLiteral("Set filter regexp"), this);
   m_ui->m_fileTable->addAction(regExpAction);
   m_ui->m_fileTree->addAction(regExpAction);
   VERIFY(QObject::connect(regExpAction, &QAction::triggered,
                           this, &MainWindow::onSetRegExp));
 
+  QAction * refreshAction = new QAction(QStringLiteral("Refresh"), this);
+  refreshAction->setShortcut(QKeySequence::Refresh);
+  m_ui->m_fileTable->addAction(refreshAction);
+  m_ui->m_fileTree->addAction(refreshAction);
+  VERIFY(QObject::connect(refreshAction, &QAction::triggered,
+                          this, &MainWindow::onRefresh));
+
+  QAction * goToAction = new QAction(QStringLiteral("Go to path"), this);
+  goToAction->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_L));
+  m_ui->m_fileTable->addAction(goToAction);
+  m_ui->m_fileTree->addAction(goToAction);
+  VERIFY(QObject::connect(goToAction, &QAction::triggered,
+                          this, &MainWindow::onGoToPath));
+
+  QAction * diagnosticsAction = new QAction(QStringLiteral("Scan diagnostics"), this);
+  m_ui->m_fileTable->addAction(diagnosticsAction);
+  m_ui->m_fileTree->addAction(diagnosticsAction);
+  VERIFY(QObject::connect(diagnosticsAction, &QAction::triggered,
+                          this, &MainWindow::onScanDiagnostics));
+
+  m_statsPanel = new StatsPanel(this);
+  addDockWidget(Qt::RightDockWidgetArea, m_statsPanel);
+  m_statsPanel->hide();
+  VERIFY(QObject::connect(m_statsPanel, &StatsPanel::pathActivated, this, &MainWindow::onStatsPathActivated));
+
+  QAction * statsAction = new QAction(QStringLiteral("Statistics of selection"), this);
+  m_ui->m_fileTable->addAction(statsAction);
+  m_ui->m_fileTree->addAction(statsAction);
+  VERIFY(QObject::connect(statsAction, &QAction::triggered, this, &MainWindow::onShowStats));
+
+  QAction * crawlPolicyAction = new QAction(QStringLiteral("Crawl policy of this root..."), this);
+  m_ui->m_fileTable->addAction(crawlPolicyAction);
+  m_ui->m_fileTree->addAction(crawlPolicyAction);
+  VERIFY(QObject::connect(crawlPolicyAction, &QAction::triggered, this, &MainWindow::onEditCrawlPolicy));
+
+  QAction * globalRulesAction = new QAction(QStringLiteral("Exclusion rules..."), this);
+  QAction * rootRulesAction = new QAction(QStringLiteral("Exclusion rules of this root..."), this);
+  for (QAction * action : { globalRulesAction, rootRulesAction })
+  {
+    m_ui->m_fileTable->addAction(action);
+    m_ui->m_fileTree->addAction(action);
+  }
+  VERIFY(QObject::connect(globalRulesAction, &QAction::triggered, this, &MainWindow::onEditGlobalRules));
+  VERIFY(QObject::connect(rootRulesAction, &QAction::triggered, this, &MainWindow::onEditRootRules));
+
+  QAction * hashAction = new QAction(QStringLiteral("Hash checked files"), this);
+  m_ui->m_fileTable->addAction(hashAction);
+  m_ui->m_fileTree->addAction(hashAction);
+  VERIFY(QObject::connect(hashAction, &QAction::triggered, m_fileModel, &FileSystemModel::hashChecked));
+
+  QAction * exportAction = new QAction(QStringLiteral("Export checked"), this);
+  m_ui->m_fileTable->addAction(exportAction);
+  m_ui->m_fileTree->addAction(exportAction);
+  VERIFY(QObject::connect(exportAction, &QAction::triggered,
+                          this, &MainWindow::onExport));
+
+  QAction * saveSnapshotAction = new QAction(QStringLiteral("Save snapshot..."), this);
+  QAction * compareAction = new QAction(QStringLiteral("Compare snapshots..."), this);
+  for (QAction * action : { saveSnapshotAction, compareAction })
+  {
+    m_ui->m_fileTable->addAction(action);
+    m_ui->m_fileTree->addAction(action);
+  }
+  VERIFY(QObject::connect(saveSnapshotAction, &QAction::triggered, this, &MainWindow::onSaveSnapshot));
+  VERIFY(QObject::connect(compareAction, &QAction::triggered, this, &MainWindow::onCompareSnapshots));
+
+  QAction * copyAction = new QAction(QStringLiteral("Copy checked to..."), this);
+  QAction * moveAction = new QAction(QStringLiteral("Move checked to..."), this);
+  QAction * deleteAction = new QAction(QStringLiteral("Delete checked"), this);
+  QAction * cancelAction = new QAction(QStringLiteral("Cancel file operation"), this);
+  for (QAction * action : { copyAction, moveAction, deleteAction, cancelAction })
+  {
+    m_ui->m_fileTable->addAction(action);
+    m_ui->m_fileTree->addAction(action);
+  }
+  VERIFY(QObject::connect(copyAction, &QAction::triggered, this, &MainWindow::onCopyChecked));
+  VERIFY(QObject::connect(moveAction, &QAction::triggered, this, &MainWindow::onMoveChecked));
+  VERIFY(QObject::connect(deleteAction, &QAction::triggered, this, &MainWindow::onDeleteChecked));
+  VERIFY(QObject::connect(cancelAction, &QAction::triggered, m_operationQueue, &FileOperationQueue::cancel));
+
+  VERIFY(QObject::connect(m_operationQueue, &FileOperationQueue::progress,
+                          this, &MainWindow::onOperationProgress));
+  VERIFY(QObject::connect(m_operationQueue, &FileOperationQueue::entryFailed,
+                          this, &MainWindow::onOperationEntryFailed));
+  VERIFY(QObject::connect(m_operationQueue, &FileOperationQueue::dirsChanged,
+                          m_fileModel, &FileSystemModel::refreshDirs));
+  VERIFY(QObject::connect(m_operationQueue, &FileOperationQueue::operationFinished,
+                          this, &MainWindow::onOperationFinished));
+
   LoadState();
 }
 
 MainWindow::~MainWindow()
 {
+  if (m_exporter != nullptr)
+    m_exporter->cancel();
+  if (m_crawler != nullptr)
+    m_crawler->cancel();
+
   SaveState();
   delete m_ui;
 }
@@ -69,7 +194,13 @@ MainWindow::~MainWindow()
 void MainWindow::LoadState()
 {
   QSettings settings("settings.ini", QSettings::IniFormat);
-  m_ui->m_rootEditor->setText(settings.value("RootPath", "").toString());
+  QString const currentRoot = settings.value("RootPath", "").toString();
+  QStringList const rootPaths = settings.value("RootPaths", QStringList(currentRoot)).toStringList();
+  m_fileModel->setMemoryBudget(settings.value("MemoryBudgetMB", 0).toLongLong() * 1024 * 1024);
+  m_operationQueue->setMaxParallelism(settings.value("FileOperationThreads", 4).toInt());
+  bool const isSha256 = settings.value("HashAlgorithm", "xxh64").toString().compare("sha256", Qt::CaseInsensitive) == 0;
+  m_fileModel->setHashAlgorithm(isSha256 ? HashService::Sha256 : HashService::Xxh64);
+  m_useGitIgnore = settings.value("UseGitIgnore", true).toBool();
 
   settings.beginGroup("MainWindow");
   QByteArray windowGeometry = settings.value("geometry", QByteArray()).toByteArray();
@@ -86,13 +217,19 @@ void MainWindow::LoadState()
   m_ui->m_fileTable->horizontalHeader()->restoreState(header);
   settings.endGroup();
 
-  onRootSpecified();
+  for (QString const & rootPath : rootPaths)
+    OpenRoot(rootPath);
+  OpenRoot(currentRoot);
 }
 
 void MainWindow::SaveState()
 {
   QSettings settings("settings.ini", QSettings::IniFormat);
-  settings.setValue("RootPath", m_ui->m_rootEditor->text());
+  QStringList rootPaths;
+  for (int i = 0; i < m_rootTabs->count(); ++i)
+    rootPaths.append(m_rootTabs->tabData(i).toString());
+  settings.setValue("RootPaths", rootPaths);
+  settings.setValue("RootPath", CurrentRoot());
 
   settings.beginGroup("MainWindow");
   settings.setValue("geometry", saveGeometry());
@@ -107,6 +244,54 @@ void MainWindow::SaveState()
   settings.endGroup();
 }
 
+void MainWindow::SetSourceModel(QAbstractItemModel * model)
+{
+  if (m_model->sourceModel() != model)
+  {
+    // views drop their expanded state on reset without emitting collapsed()
+    m_fileModel->resetExpanded();
+    m_tableRoot = QPersistentModelIndex();
+    m_model->setSourceModel(model);
+  }
+
+  for (int i = 1; i < m_model->columnCount(QModelIndex()); ++i)
+    m_ui->m_fileTree->hideColumn(i);
+}
+
+bool MainWindow::IsDir(QModelIndex const & index) const
+{
+  QModelIndex sourceIndex = m_model->mapToSource(index);
+  if (m_model->sourceModel() == m_filterModel)
+    return m_filterModel->isDir(sourceIndex);
+
+  return m_fileModel->isDir(sourceIndex);
+}
+
+void MainWindow::SetTableRoot(QModelIndex const & index)
+{
+  m_ui->m_fileTable->setRootIndex(index);
+
+  m_fileModel->setExpanded(m_tableRoot, false);
+  m_tableRoot = QPersistentModelIndex();
+  if (m_model->sourceModel() == m_fileModel)
+  {
+    m_tableRoot = m_model->mapToSource(index);
+    m_fileModel->setExpanded(m_tableRoot, true);
+  }
+}
+
+void MainWindow::SelectSourceIndex(QModelIndex const & sourceIndex)
+{
+  SetSourceModel(m_fileModel);
+
+  QModelIndex index = m_model->mapFromSource(sourceIndex);
+  if (!index.isValid())
+    return;
+
+  m_ui->m_fileTree->scrollTo(index);
+  m_ui->m_fileTree->setCurrentIndex(index);
+}
+
 void MainWindow::onRootDialogCall()
 {
   QString dir = QFileDialog::getExistingDirectory(this, "Select root", "");
@@ -119,8 +304,467 @@ void MainWindow::onRootDialogCall()
 
 void MainWindow::onRootSpecified()
 {
-  QString rootDir = m_ui->m_rootEditor->text();
-  m_fileModel->setRoot(rootDir);
+  OpenRoot(m_ui->m_rootEditor->text());
+}
+
+QString MainWindow::CurrentRoot() const
+{
+  return m_rootTabs->tabData(m_rootTabs->currentIndex()).toString();
+}
+
+void MainWindow::OpenRoot(QString const & rootPath)
+{
+  if (rootPath.isEmpty())
+    return;
+
+  QString const cleanPath = QDir::cleanPath(QFileInfo(rootPath).absoluteFilePath());
+  int tab = 0;
+  while (tab < m_rootTabs->count() && m_rootTabs->tabData(tab).toString() != cleanPath)
+    ++tab;
+
+  if (tab == m_rootTabs->count())
+  {
+    ApplyRules(cleanPath);
+    m_fileModel->addRoot(cleanPath);
+    if (!m_fileModel->roots().contains(cleanPath))
+    {
+      m_ui->statusBar->showMessage(QStringLiteral("%1 does not exist").arg(rootPath), 3000);
+      return;
+    }
+
+    QSignalBlocker blocker(m_rootTabs);
+    QString const name = QFileInfo(cleanPath).fileName();
+    tab = m_rootTabs->addTab(name.isEmpty() ? cleanPath : name);
+    m_rootTabs->setTabData(tab, cleanPath);
+    m_rootTabs->setTabToolTip(tab, cleanPath);
+  }
+
+  {
+    QSignalBlocker blocker(m_rootTabs);
+    m_rootTabs->setCurrentIndex(tab);
+  }
+  ShowRoot(cleanPath);
+}
+
+void MainWindow::ShowRoot(QString const & rootPath)
+{
+  m_ui->m_rootEditor->setText(rootPath);
+  if (rootPath.isEmpty())
+    return;
+
+  if (m_model->sourceModel() == m_filterModel)
+    m_filterModel->setFilter(m_fileModel->crawlRoot(rootPath), m_filterModel->filterRegExp());
+
+  // a root nested in another one is loaded directory by directory on the first switch
+  m_fileModel->loadPath(rootPath, [this, rootPath](QModelIndex const & index)
+  {
+    if (CurrentRoot() == rootPath && m_model->sourceModel() == m_fileModel)
+      SelectSourceIndex(index);
+  });
+}
+
+void MainWindow::ApplyRules(QString const & rootPath)
+{
+  // global rules first, so rules of the root override them
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  QStringList rules = settings.value("ExcludeRules").toStringList();
+  rules.append(settings.value("RootExcludeRules").toMap().value(rootPath).toStringList());
+  m_fileModel->setIgnoreRules(rules, m_useGitIgnore);
+}
+
+void MainWindow::ReloadRoots()
+{
+  m_fileModel->clearRoots();
+  for (int i = 0; i < m_rootTabs->count(); ++i)
+  {
+    QString const rootPath = m_rootTabs->tabData(i).toString();
+    ApplyRules(rootPath);
+    m_fileModel->addRoot(rootPath);
+  }
+
+  ShowRoot(CurrentRoot());
+}
+
+void MainWindow::onRootTabChanged(int index)
+{
+  ShowRoot(m_rootTabs->tabData(index).toString());
+}
+
+void MainWindow::onRootTabClosed(int index)
+{
+  m_fileModel->removeRoot(m_rootTabs->tabData(index).toString());
+  m_rootTabs->removeTab(index);
+}
+
+void MainWindow::onRefresh()
+{
+  m_fileModel->refresh();
+}
+
+void MainWindow::onGoToPath()
+{
+  QString path = QInputDialog::getText(this, QStringLiteral("Go to path"), QStringLiteral("Path :"));
+  if (path.isEmpty())
+    return;
+
+  QModelIndex index = m_fileModel->revealPath(path);
+  if (index.isValid())
+    SelectSourceIndex(index);
+  else
+    m_ui->statusBar->showMessage(QStringLiteral("%1 is not loaded").arg(path), 3000);
+}
+
+void MainWindow::onEditGlobalRules()
+{
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  QStringList rules = settings.value("ExcludeRules").toStringList();
+  if (!EditRules(QStringLiteral("Exclusion rules of every root"), rules))
+    return;
+
+  settings.setValue("ExcludeRules", rules);
+  settings.sync();
+  ReloadRoots();
+}
+
+void MainWindow::onEditRootRules()
+{
+  QString const rootDir = CurrentRoot();
+  if (rootDir.isEmpty())
+    return;
+
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  QVariantMap rootRules = settings.value("RootExcludeRules").toMap();
+  QStringList rules = rootRules.value(rootDir).toStringList();
+  if (!EditRules(QStringLiteral("Exclusion rules of %1").arg(rootDir), rules))
+    return;
+
+  if (rules.isEmpty())
+    rootRules.remove(rootDir);
+  else
+    rootRules.insert(rootDir, rules);
+  settings.setValue("RootExcludeRules", rootRules);
+  settings.sync();
+  ReloadRoots();
+}
+
+void MainWindow::onEditCrawlPolicy()
+{
+  QString const rootDir = CurrentRoot();
+  if (rootDir.isEmpty())
+    return;
+
+  QStringList const policies = {
+    QStringLiteral("Cross mount points, skip links"),
+    QStringLiteral("Cross mount points, follow links"),
+    QStringLiteral("Stay on this file system, skip links"),
+    QStringLiteral("Stay on this file system, follow links")
+  };
+
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  QVariantMap rootPolicies = settings.value("RootCrawlPolicy").toMap();
+  int const current = rootPolicies.value(rootDir, 0).toInt();
+  bool accepted = false;
+  QString const policy = QInputDialog::getItem(this, QStringLiteral("Crawl policy of %1").arg(rootDir),
+                                               QStringLiteral("Statistics of this root are collected:"),
+                                               policies, qBound(0, current, policies.size() - 1), false, &accepted);
+  if (!accepted)
+    return;
+
+  int const selected = policies.indexOf(policy);
+  if (selected == 0)
+    rootPolicies.remove(rootDir);
+  else
+    rootPolicies.insert(rootDir, selected);
+  settings.setValue("RootCrawlPolicy", rootPolicies);
+}
+
+void MainWindow::ApplyCrawlPolicy(CrawlRoot & root) const
+{
+  // the innermost open root wins, roots can be opened inside each other
+  QString rootDir;
+  for (int i = 0; i < m_rootTabs->count(); ++i)
+  {
+    QString const tabPath = m_rootTabs->tabData(i).toString();
+    QString const prefix = tabPath.endsWith('/') ? tabPath : tabPath + '/';
+    if ((root.m_path == tabPath || root.m_path.startsWith(prefix)) && tabPath.size() > rootDir.size())
+      rootDir = tabPath;
+  }
+
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  int const policy = settings.value("RootCrawlPolicy").toMap().value(rootDir, 0).toInt();
+  root.m_followSymLinks = (policy & 1) != 0;
+  root.m_sameDevice = (policy & 2) != 0;
+}
+
+bool MainWindow::EditRules(QString const & title, QStringList & rules)
+{
+  bool accepted = false;
+  QString const text = QInputDialog::getMultiLineText(this, title,
+                                                      QStringLiteral("One gitignore style pattern per line, ! re-includes:"),
+                                                      rules.join('\n'), &accepted);
+  if (!accepted)
+    return false;
+
+  rules = text.split('\n', QString::SkipEmptyParts);
+  return true;
+}
+
+void MainWindow::onScanDiagnostics()
+{
+  QMessageBox::information(this, QStringLiteral("Scan diagnostics"), m_fileModel->scanDiagnostics());
+}
+
+void MainWindow::onShowStats()
+{
+  if (m_model->sourceModel() != m_fileModel)
+    return;
+
+  QModelIndex const index = m_model->mapToSource(m_ui->m_fileTree->currentIndex());
+  CrawlRoot root = m_fileModel->crawlRoot(index);
+  if (root.m_path.isEmpty())
+  {
+    m_ui->statusBar->showMessage(QStringLiteral("Select a directory"), 3000);
+    return;
+  }
+
+  ApplyCrawlPolicy(root);
+
+  // reports of the canceled crawl are dropped, it deletes itself when it stops
+  if (m_crawler != nullptr)
+    m_crawler->cancel();
+
+  m_crawlPath = root.m_path;
+  m_crawler = new ParallelCrawler(root);
+  VERIFY(QObject::connect(m_crawler, &ParallelCrawler::progress,
+                          this, &MainWindow::onCrawlProgress, Qt::QueuedConnection));
+  m_crawler->setAutoDelete(false);
+  QThreadPool::globalInstance()->start(m_crawler);
+
+  m_statsPanel->setStats(m_crawlPath, CrawlStats(), false);
+  m_statsPanel->show();
+}
+
+void MainWindow::onCrawlProgress(CrawlStats const & stats, bool finished, ParallelCrawler * crawler)
+{
+  bool const isCurrent = crawler == m_crawler;
+  if (finished)
+  {
+    crawler->deleteLater();
+    if (isCurrent)
+      m_crawler = nullptr;
+  }
+
+  if (isCurrent)
+    m_statsPanel->setStats(m_crawlPath, stats, finished);
+}
+
+void MainWindow::onStatsPathActivated(QString const & path)
+{
+  // directories on the way are listed one by one, nothing else below the root is expanded
+  SetSourceModel(m_fileModel);
+  m_fileModel->loadPath(path, [this](QModelIndex const & index)
+  {
+    if (m_model->sourceModel() == m_fileModel)
+      SelectSourceIndex(index);
+  });
+}
+
+void MainWindow::onExport()
+{
+  if (m_exporter != nullptr)
+  {
+    m_ui->statusBar->showMessage(QStringLiteral("Export is already running"), 3000);
+    return;
+  }
+
+  QString const tsvFilter = QStringLiteral("Tab separated (*.tsv)");
+  QString const jsonFilter = QStringLiteral("JSON Lines (*.jsonl)");
+  QString const nulFilter = QStringLiteral("NUL separated paths (*)");
+  QString selectedFilter = tsvFilter;
+  QString target = QFileDialog::getSaveFileName(this, QStringLiteral("Export checked"), QString(),
+                                                tsvFilter + ";;" + jsonFilter + ";;" + nulFilter, &selectedFilter);
+  if (target.isEmpty())
+    return;
+
+  Exporter::EFormat format = Exporter::Tsv;
+  if (selectedFilter == jsonFilter)
+    format = Exporter::JsonLines;
+  else if (selectedFilter == nulFilter)
+    format = Exporter::NulSeparated;
+
+  m_exporter = new Exporter(m_fileModel->checkedSnapshot(), target, format, Exporter::AllColumns);
+  VERIFY(QObject::connect(m_exporter, &Exporter::progress,
+                          this, &MainWindow::onExportProgress, Qt::QueuedConnection));
+  VERIFY(QObject::connect(m_exporter, &Exporter::exportFinished,
+                          this, &MainWindow::onExportFinished, Qt::QueuedConnection));
+  m_exporter->setAutoDelete(false);
+  QThreadPool::globalInstance()->start(m_exporter);
+}
+
+void MainWindow::onExportProgress(quint64 entryCount, Exporter * exporter)
+{
+  if (exporter == m_exporter)
+    m_ui->statusBar->showMessage(QStringLiteral("Exporting: %1 entries").arg(entryCount));
+}
+
+void MainWindow::onExportFinished(quint64 entryCount, QString const & error, Exporter * exporter)
+{
+  if (exporter == m_exporter)
+    m_exporter = nullptr;
+
+  exporter->deleteLater();
+  if (error.isEmpty())
+    m_ui->statusBar->showMessage(QStringLiteral("Exported %1 entries").arg(entryCount), 5000);
+  else
+    m_ui->statusBar->showMessage(QStringLiteral("Export failed after %1 entries: %2").arg(entryCount).arg(error), 5000);
+}
+
+void MainWindow::onSaveSnapshot()
+{
+  QString path = QFileDialog::getSaveFileName(this, QStringLiteral("Save snapshot"), QString(),
+                                              QStringLiteral("Snapshots (*.lfsnap)"));
+  if (path.isEmpty())
+    return;
+
+  SnapshotSaver * saver = new SnapshotSaver(m_fileModel->takeSnapshot(CurrentRoot()), path);
+  VERIFY(QObject::connect(saver, &SnapshotSaver::saveFinished,
+                          this, &MainWindow::onSnapshotSaved, Qt::QueuedConnection));
+  saver->setAutoDelete(false);
+  QThreadPool::globalInstance()->start(saver);
+}
+
+void MainWindow::onSnapshotSaved(QString const & error, SnapshotSaver * saver)
+{
+  saver->deleteLater();
+  if (error.isEmpty())
+    m_ui->statusBar->showMessage(QStringLiteral("Snapshot saved"), 3000);
+  else
+    m_ui->statusBar->showMessage(QStringLiteral("Snapshot is not saved: %1").arg(error), 5000);
+}
+
+void MainWindow::onCompareSnapshots()
+{
+  QString const filter = QStringLiteral("Snapshots (*.lfsnap)");
+  QString oldPath = QFileDialog::getOpenFileName(this, QStringLiteral("Old snapshot"), QString(), filter);
+  if (oldPath.isEmpty())
+    return;
+
+  // the loaded tree is the usual "now", another file is picked only on request
+  std::shared_ptr<ScanSnapshot> liveSnapshot;
+  QString newPath;
+  if (QMessageBox::question(this, QStringLiteral("Compare snapshots"),
+                            QStringLiteral("Compare with the loaded tree? Choose No to pick a newer snapshot file.")) == QMessageBox::Yes)
+  {
+    liveSnapshot = m_fileModel->takeSnapshot(CurrentRoot());
+  }
+  else
+  {
+    newPath = QFileDialog::getOpenFileName(this, QStringLiteral("New snapshot"), QString(), filter);
+    if (newPath.isEmpty())
+      return;
+  }
+
+  SnapshotDiffer * differ = new SnapshotDiffer(nullptr, oldPath, liveSnapshot, newPath);
+  VERIFY(QObject::connect(differ, &SnapshotDiffer::diffFinished,
+                          this, &MainWindow::onDiffFinished, Qt::QueuedConnection));
+  differ->setAutoDelete(false);
+  QThreadPool::globalInstance()->start(differ);
+  m_ui->statusBar->showMessage(QStringLiteral("Comparing snapshots..."));
+}
+
+void MainWindow::onDiffFinished(DiffNode * root, QString const & error, SnapshotDiffer * differ)
+{
+  differ->deleteLater();
+  std::unique_ptr<DiffNode> diff(root);
+  if (!error.isEmpty())
+  {
+    m_ui->statusBar->showMessage(QStringLiteral("Snapshots are not compared: %1").arg(error), 5000);
+    return;
+  }
+
+  m_ui->statusBar->clearMessage();
+
+  QDialog * dialog = new QDialog(this);
+  dialog->setAttribute(Qt::WA_DeleteOnClose);
+  dialog->setWindowTitle(QStringLiteral("Changes"));
+
+  DiffModel * model = new DiffModel(dialog);
+  model->setDiff(std::move(diff));
+
+  QTreeView * view = new QTreeView(dialog);
+  view->setModel(model);
+  view->expand(model->index(0, 0, QModelIndex()));
+
+  QVBoxLayout * layout = new QVBoxLayout(dialog);
+  layout->addWidget(view);
+  dialog->resize(800, 600);
+  dialog->show();
+}
+
+void MainWindow::StartOperation(FileOperationTask::EOperation operation, QString const & targetDir)
+{
+  if (m_operationQueue->isRunning())
+  {
+    m_ui->statusBar->showMessage(QStringLiteral("A file operation is already running"), 3000);
+    return;
+  }
+
+  m_operationErrors.clear();
+  m_operationQueue->start(operation, m_fileModel->checkedPaths(), targetDir);
+}
+
+void MainWindow::onCopyChecked()
+{
+  QString dir = QFileDialog::getExistingDirectory(this, QStringLiteral("Copy checked to"), "");
+  if (!dir.isEmpty())
+    StartOperation(FileOperationTask::Copy, dir);
+}
+
+void MainWindow::onMoveChecked()
+{
+  QString dir = QFileDialog::getExistingDirectory(this, QStringLiteral("Move checked to"), "");
+  if (!dir.isEmpty())
+    StartOperation(FileOperationTask::Move, dir);
+}
+
+void MainWindow::onDeleteChecked()
+{
+  QStringList paths = m_fileModel->checkedPaths();
+  if (paths.isEmpty())
+    return;
+
+  QString question = QStringLiteral("Delete %1 checked entries with everything inside them?").arg(paths.size());
+  if (QMessageBox::question(this, QStringLiteral("Delete checked"), question) != QMessageBox::Yes)
+    return;
+
+  StartOperation(FileOperationTask::Delete, QString());
+}
+
+void MainWindow::onOperationProgress(int finishedCount, int totalCount, quint64 entryCount, qint64 byteCount)
+{
+  m_ui->statusBar->showMessage(QStringLiteral("%1 of %2 done: %3 entries, %4 MB")
+                               .arg(finishedCount).arg(totalCount).arg(entryCount).arg(byteCount / (1024 * 1024)));
+}
+
+void MainWindow::onOperationEntryFailed(QString const & path, QString const & error)
+{
+  int const MaxShownErrors = 20;
+  if (m_operationErrors.size() < MaxShownErrors)
+    m_operationErrors.append(QStringLiteral("%1: %2").arg(path).arg(error));
+}
+
+void MainWindow::onOperationFinished(bool canceled, int errorCount)
+{
+  QString message = canceled ? QStringLiteral("File operation canceled") : QStringLiteral("File operation finished");
+  if (errorCount == 0)
+  {
+    m_ui->statusBar->showMessage(message, 5000);
+    return;
+  }
+
+  message = QStringLiteral("%1 with %2 errors").arg(message).arg(errorCount);
+  m_ui->statusBar->showMessage(message, 5000);
+  QMessageBox::warning(this, QStringLiteral("File operation"), message + "\n\n" + m_operationErrors.join('\n'));
 }
 
 namespace
@@ -163,6 +807,9 @@ void MainWindow::onTableSelectionChanged(QItemSelection const & selected, QItemS
     item = item.parent();
   }
 
+  if (m_model->sourceModel() != m_fileModel)
+    return;
+
   QModelIndex sourceIndex = m_model->mapToSource(lst.first());
   if (m_fileModel->canFetchMore(sourceIndex))
     m_fileModel->fetchMore(sourceIndex);
@@ -179,21 +826,33 @@ void MainWindow::onTreeSelectionChanged(QItemSelection const & selected, QItemSe
 
   QModelIndex index = lst.first();
   QModelIndex currentRoot = m_ui->m_fileTable->rootIndex();
-  if (m_fileModel->isDir(m_model->mapToSource(index)) && index != currentRoot)
+  if (IsDir(index) && index != currentRoot)
   {
-    m_ui->m_fileTable->setRootIndex(index);
+    SetTableRoot(index);
     m_ui->m_fileTable->selectionModel()->clear();
   }
   else
   {
     QModelIndex idxParent = index.parent();
     if (idxParent != currentRoot)
-      m_ui->m_fileTable->setRootIndex(idxParent);
+      SetTableRoot(idxParent);
 
     m_ui->m_fileTable->selectionModel()->select(selected, QItemSelectionModel::ClearAndSelect);
   }
 }
 
+void MainWindow::onTreeExpanded(QModelIndex const & index)
+{
+  if (m_model->sourceModel() == m_fileModel)
+    m_fileModel->setExpanded(m_model->mapToSource(index), true);
+}
+
+void MainWindow::onTreeCollapsed(QModelIndex const & index)
+{
+  if (m_model->sourceModel() == m_fileModel)
+    m_fileModel->setExpanded(m_model->mapToSource(index), false);
+}
+
 void MainWindow::onResizeColumns()
 {
   m_ui->m_fileTable->horizontalHeader()->resizeSections(QHeaderView::ResizeToContents);
@@ -202,12 +861,21 @@ void MainWindow::onResizeColumns()
 
 void MainWindow::onSetRegExp()
 {
-  RegExpDialog dlg(m_model->filterRegExp(), this);
+  RegExpDialog dlg(m_filterModel->filterRegExp(), m_fileModel->loadedNames(), this);
+
+  if (dlg.exec() != QDialog::Accepted)
+    return;
 
-  if (dlg.exec() == QDialog::Accepted)
+  // matches are searched on disk by FilterModel, the proxy is never asked to re-filter the tree
+  QRegExp const & regExp = dlg.GetRegExp();
+  if (regExp.isEmpty())
+  {
+    SetSourceModel(m_fileModel);
+    m_filterModel->clearFilter();
+  }
+  else
   {
-    m_model->setFilterRole(Qt::DisplayRole);
-    m_model->setFilterKeyColumn(0);
-    m_model->setFilterRegExp(dlg.GetRegExp());
+    m_filterModel->setFilter(m_fileModel->crawlRoot(CurrentRoot()), regExp);
+    SetSourceModel(m_filterModel);
   }
 }
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "file_operation_task.hpp"
 #include "file_system_model.hpp"
+#include "filter_model.hpp"
 
 #include <QMainWindow>
 #include <QSortFilterProxyModel>
 
+class QTabBar;
+
 namespace Ui
 {
 
@@ -12,6 +16,15 @@ class MainWindow;
 
 } // namespace Ui
 
+class Exporter;
+class FileOperationQueue;
+class ParallelCrawler;
+class StatsPanel;
+struct CrawlStats;
+class SnapshotSaver;
+class SnapshotDiffer;
+struct DiffNode;
+
 class MainWindow : public QMainWindow
 {
   Q_OBJECT
@@ -24,21 +37,84 @@ private:
   void LoadState();
   void SaveState();
 
+  void SetSourceModel(QAbstractItemModel * model);
+  bool IsDir(QModelIndex const & index) const;
+  void SetTableRoot(QModelIndex const & index);
+  void SelectSourceIndex(QModelIndex const & sourceIndex);
+  void StartOperation(FileOperationTask::EOperation operation, QString const & targetDir);
+  bool EditRules(QString const & title, QStringList & rules);
+  /// Mount point and link handling chosen for the open root that contains the crawl
+  void ApplyCrawlPolicy(CrawlRoot & root) const;
+
+  QString CurrentRoot() const;
+  /// Opens a tab for the root or switches to its tab
+  void OpenRoot(QString const & rootPath);
+  void ShowRoot(QString const & rootPath);
+  /// Sets the rules of the root before it is added
+  void ApplyRules(QString const & rootPath);
+  /// Rules changed, every root is scanned again
+  void ReloadRoots();
+
 private:
   Q_SLOT void onRootDialogCall();
   Q_SLOT void onRootSpecified();
+  Q_SLOT void onRootTabChanged(int index);
+  Q_SLOT void onRootTabClosed(int index);
+  Q_SLOT void onRefresh();
+  Q_SLOT void onGoToPath();
+  Q_SLOT void onEditGlobalRules();
+  Q_SLOT void onEditRootRules();
+  Q_SLOT void onEditCrawlPolicy();
+  Q_SLOT void onScanDiagnostics();
+  Q_SLOT void onShowStats();
+  Q_SLOT void onCrawlProgress(CrawlStats const & stats, bool finished, ParallelCrawler * crawler);
+  Q_SLOT void onStatsPathActivated(QString const & path);
+  Q_SLOT void onExport();
+  Q_SLOT void onExportProgress(quint64 entryCount, Exporter * exporter);
+  Q_SLOT void onExportFinished(quint64 entryCount, QString const & error, Exporter * exporter);
+
+  Q_SLOT void onSaveSnapshot();
+  Q_SLOT void onSnapshotSaved(QString const & error, SnapshotSaver * saver);
+  Q_SLOT void onCompareSnapshots();
+  Q_SLOT void onDiffFinished(DiffNode * root, QString const & error, SnapshotDiffer * differ);
+
+  Q_SLOT void onCopyChecked();
+  Q_SLOT void onMoveChecked();
+  Q_SLOT void onDeleteChecked();
+  Q_SLOT void onOperationProgress(int finishedCount, int totalCount, quint64 entryCount, qint64 byteCount);
+  Q_SLOT void onOperationEntryFailed(QString const & path, QString const & error);
+  Q_SLOT void onOperationFinished(bool canceled, int errorCount);
 
   Q_SLOT void onTreeSelectionChanged(QItemSelection const & selected, QItemSelection const & deselected);
   Q_SLOT void onTableSelectionChanged(QItemSelection const & selected, QItemSelection const & deselected);
 
+  Q_SLOT void onTreeExpanded(QModelIndex const & index);
+  Q_SLOT void onTreeCollapsed(QModelIndex const & index);
+
   Q_SLOT void onResizeColumns();
   Q_SLOT void onSetRegExp();
 
 private:
   Ui::MainWindow * m_ui;
+  /// One tab per open root, the tab data is its clean path
+  QTabBar * m_rootTabs;
 
   FileSystemModel * m_fileModel;
+  FilterModel * m_filterModel;
   QSortFilterProxyModel * m_model;
+  /// file model index the table is rooted at, kept expanded so it is never evicted
+  QPersistentModelIndex m_tableRoot;
+  /// running export, at most one at a time
+  Exporter * m_exporter;
+  FileOperationQueue * m_operationQueue;
+  StatsPanel * m_statsPanel;
+  /// crawl shown in the statistics panel, a new one cancels it
+  ParallelCrawler * m_crawler;
+  QString m_crawlPath;
+  /// first errors of the running file operation, shown when it finishes
+  QStringList m_operationErrors;
 
+  /// .gitignore files are honoured by scans, read once from the settings
+  bool m_useGitIgnore;
   bool m_ignoreTableSelection;
 };
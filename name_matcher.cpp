@@ -0,0 +1,158 @@
+#include "name_matcher.hpp"
+
+#include <QElapsedTimer>
+#include <QStringMatcher>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+
+namespace
+{
+
+/// Smaller lists are not worth waking another thread for
+size_t const MinChunkSize = 16 * 1024;
+
+/// Names matched between two looks at the cancel flag
+size_t const CancelCheckInterval = 4096;
+
+/// Patterns that match the same as a plain substring search
+bool IsPlainString(QString const & pattern, QRegExp::PatternSyntax syntax)
+{
+  switch (syntax)
+  {
+  case QRegExp::FixedString:
+    return true;
+  case QRegExp::RegExp:
+  case QRegExp::RegExp2:
+    return QRegExp::escape(pattern) == pattern;
+  case QRegExp::Wildcard:
+  case QRegExp::WildcardUnix:
+    return std::none_of(pattern.begin(), pattern.end(),
+                        [](QChar c) { return c == '*' || c == '?' || c == '[' || c == '\\'; });
+  default:
+    return false;
+  }
+}
+
+/// Matches a contiguous range of the list, every chunk has its own matcher
+class ChunkMatcher : public QRunnable
+{
+public:
+  ChunkMatcher(NameList const & names, size_t begin, size_t end, QString const & pattern,
+               Qt::CaseSensitivity caseSensitivity, QRegExp::PatternSyntax syntax, int sampleSize,
+               std::atomic<bool> const & canceled)
+    : m_names(names)
+    , m_begin(begin)
+    , m_end(end)
+    , m_pattern(pattern)
+    , m_caseSensitivity(caseSensitivity)
+    , m_syntax(syntax)
+    , m_sampleSize(sampleSize)
+    , m_canceled(canceled)
+  {
+  }
+
+  quint64 m_matchCount = 0;
+  QStringList m_sample;
+
+protected:
+  void run()
+  {
+    if (IsPlainString(m_pattern, m_syntax))
+    {
+      // Boyer-Moore over the pooled characters, no string is built per name
+      QStringMatcher const matcher(m_pattern, m_caseSensitivity);
+      Match([&matcher](QChar const * data, int length) { return matcher.indexIn(data, length) != -1; });
+    }
+    else
+    {
+      // own instance, QRegExp keeps match state and must not be shared between threads
+      QRegExp regExp(m_pattern, m_caseSensitivity, m_syntax);
+      Match([&regExp](QChar const * data, int length)
+      {
+        return regExp.indexIn(QString::fromRawData(data, length)) != -1;
+      });
+    }
+  }
+
+private:
+  template <typename TMatch>
+  void Match(TMatch const & match)
+  {
+    NamePool const & pool = *m_names.m_pool;
+    for (size_t i = m_begin; i < m_end; ++i)
+    {
+      if ((i - m_begin) % CancelCheckInterval == 0 && m_canceled == true)
+        return;
+
+      NameRef const name = m_names.m_names[i];
+      if (!match(pool.Data(name), name.m_length))
+        continue;
+
+      ++m_matchCount;
+      if (m_sample.size() < m_sampleSize)
+        m_sample.append(pool.Get(name));
+    }
+  }
+
+  NameList const & m_names;
+  size_t m_begin;
+  size_t m_end;
+  QString m_pattern;
+  Qt::CaseSensitivity m_caseSensitivity;
+  QRegExp::PatternSyntax m_syntax;
+  int m_sampleSize;
+  std::atomic<bool> const & m_canceled;
+};
+
+} // namespace
+
+NameMatcher::NameMatcher(std::shared_ptr<NameList const> const & names, QRegExp const & regExp, int sampleSize)
+  : m_names(names)
+  , m_pattern(regExp.pattern())
+  , m_caseSensitivity(regExp.caseSensitivity())
+  , m_syntax(regExp.patternSyntax())
+  , m_sampleSize(sampleSize)
+  , m_canceled(false)
+{
+}
+
+void NameMatcher::cancel()
+{
+  m_canceled = true;
+}
+
+void NameMatcher::run()
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  size_t const nameCount = m_names->m_names.size();
+  size_t const threadCount = static_cast<size_t>(std::max(1, QThread::idealThreadCount()));
+  size_t const chunkSize = std::max(MinChunkSize, (nameCount + threadCount - 1) / threadCount);
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(static_cast<int>(threadCount));
+  std::vector<std::unique_ptr<ChunkMatcher> > chunks;
+  for (size_t begin = 0; begin < nameCount; begin += chunkSize)
+  {
+    chunks.emplace_back(new ChunkMatcher(*m_names, begin, std::min(nameCount, begin + chunkSize), m_pattern,
+                                         m_caseSensitivity, m_syntax, m_sampleSize, m_canceled));
+    chunks.back()->setAutoDelete(false);
+    pool.start(chunks.back().get());
+  }
+  pool.waitForDone();
+
+  MatchResult result;
+  result.m_nameCount = nameCount;
+  for (std::unique_ptr<ChunkMatcher> const & chunk : chunks)
+  {
+    result.m_matchCount += chunk->m_matchCount;
+    for (int i = 0; i < chunk->m_sample.size() && result.m_sample.size() < m_sampleSize; ++i)
+      result.m_sample.append(chunk->m_sample[i]);
+  }
+  result.m_elapsedMSecs = timer.elapsed();
+
+  emit matchFinished(result, m_canceled == true, this);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "name_pool.hpp"
+
+#include <QMetaType>
+#include <QObject>
+#include <QRegExp>
+#include <QRunnable>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// Names of the entries a model has loaded, the shared pool keeps them readable after the model drops nodes
+struct NameList
+{
+  std::shared_ptr<NamePool> m_pool;
+  std::vector<NameRef> m_names;
+};
+
+struct MatchResult
+{
+  quint64 m_nameCount = 0;
+  quint64 m_matchCount = 0;
+  /// the first matching names in tree order
+  QStringList m_sample;
+  qint64 m_elapsedMSecs = 0;
+};
+
+Q_DECLARE_METATYPE(MatchResult)
+
+/// Counts the names that contain a match of a pattern with a thread per core.
+/// Patterns without special characters are searched as plain strings.
+class NameMatcher : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  NameMatcher(std::shared_ptr<NameList const> const & names, QRegExp const & regExp, int sampleSize);
+
+  void cancel();
+
+  /// Emitted for canceled runs as well, so the receiver can tell the matchers apart
+  Q_SIGNAL void matchFinished(MatchResult const & result, bool canceled, NameMatcher * matcher);
+
+protected:
+  void run();
+
+private:
+  std::shared_ptr<NameList const> m_names;
+  QString m_pattern;
+  Qt::CaseSensitivity m_caseSensitivity;
+  QRegExp::PatternSyntax m_syntax;
+  int m_sampleSize;
+  std::atomic<bool> m_canceled;
+};
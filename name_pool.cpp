@@ -0,0 +1,176 @@
+#include "name_pool.hpp"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+
+int NamePool::CompareUnits(QChar const * l, int lLength, QChar const * r, int rLength)
+{
+  int const length = std::min(lLength, rLength);
+  for (int i = 0; i < length; ++i)
+  {
+    if (l[i].unicode() != r[i].unicode())
+      return l[i].unicode() < r[i].unicode() ? -1 : 1;
+  }
+
+  return lLength - rLength;
+}
+
+NamePool::NamePool()
+  : m_blocks(new std::atomic<QChar *>[MaxBlocks])
+  , m_usedBytes(0)
+  , m_failedCount(0)
+{
+  for (quint32 i = 0; i < MaxBlocks; ++i)
+    m_blocks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+NamePool::~NamePool()
+{
+  for (quint32 i = 0; i < MaxBlocks; ++i)
+    delete [] m_blocks[i].load(std::memory_order_relaxed);
+}
+
+bool NamePool::Intern(QString const & name, NameRef & ref)
+{
+  return Intern(name.constData(), name.size(), ref);
+}
+
+bool NamePool::Intern(QChar const * data, int length, NameRef & ref)
+{
+  Q_ASSERT(length < 0xFFFF);
+  length = std::min(length, 0xFFFF);
+  if (length == 0)
+  {
+    ref = NameRef();
+    return true;
+  }
+
+  quint32 const hash = Hash(data, length);
+
+  QMutexLocker lock(&m_writeMutex);
+
+  // at most half of the slots are used, so a probe ends soon
+  if ((m_nameCount + 1) * 2 > m_table.size())
+    GrowTable();
+
+  size_t const slot = FindSlot(data, length, hash);
+  if (m_table[slot].m_length != 0)
+  {
+    ref = m_table[slot];
+    return true;
+  }
+
+  // a name never straddles two blocks
+  quint64 used = m_used;
+  if (used % BlockSize + length > BlockSize)
+    used += BlockSize - used % BlockSize;
+
+  quint64 const block = used >> BlockBits;
+  if (block >= MaxBlocks)
+  {
+    ++m_failedCount;
+    return false;
+  }
+
+  QChar * blockData = m_blocks[block].load(std::memory_order_relaxed);
+  if (blockData == nullptr)
+  {
+    blockData = new QChar[BlockSize];
+    m_blocks[block].store(blockData, std::memory_order_release);
+    m_usedBytes += BlockSize * sizeof(QChar);
+  }
+
+  NameRef added;
+  added.m_offset = static_cast<quint32>(used);
+  added.m_length = static_cast<quint16>(length);
+
+  std::memcpy(blockData + used % BlockSize, data, length * sizeof(QChar));
+  m_used = used + length;
+  m_table[slot] = added;
+  ++m_nameCount;
+
+  ref = added;
+  return true;
+}
+
+quint32 NamePool::Hash(QChar const * data, int length)
+{
+  // FNV-1a over the code units
+  quint32 hash = 2166136261u;
+  for (int i = 0; i < length; ++i)
+  {
+    hash ^= data[i].unicode();
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+size_t NamePool::FindSlot(QChar const * data, int length, quint32 hash) const
+{
+  // the table size is a power of two
+  size_t const mask = m_table.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+  {
+    NameRef const candidate = m_table[slot];
+    if (candidate.m_length == 0 ||
+        (candidate.m_length == length && std::memcmp(Data(candidate), data, length * sizeof(QChar)) == 0))
+      return slot;
+  }
+}
+
+void NamePool::GrowTable()
+{
+  size_t const MinTableSize = 1024;
+  std::vector<NameRef> table(std::max(MinTableSize, m_table.size() * 2));
+  m_usedBytes += static_cast<qint64>((table.size() - m_table.size()) * sizeof(NameRef));
+  table.swap(m_table);
+
+  for (NameRef const ref : table)
+  {
+    if (ref.m_length == 0)
+      continue;
+
+    QChar const * data = Data(ref);
+    m_table[FindSlot(data, ref.m_length, Hash(data, ref.m_length))] = ref;
+  }
+}
+
+QString NamePool::Get(NameRef ref) const
+{
+  return QString(Data(ref), ref.m_length);
+}
+
+QChar const * NamePool::Data(NameRef ref) const
+{
+  QChar const * block = m_blocks[ref.m_offset >> BlockBits].load(std::memory_order_acquire);
+  if (block == nullptr)
+  {
+    Q_ASSERT(ref.m_length == 0);
+    return nullptr;
+  }
+
+  return block + ref.m_offset % BlockSize;
+}
+
+int NamePool::Compare(NameRef l, NameRef r) const
+{
+  return CompareUnits(Data(l), l.m_length, Data(r), r.m_length);
+}
+
+int NamePool::Compare(NameRef l, QString const & r) const
+{
+  return CompareUnits(Data(l), l.m_length, r.constData(), r.size());
+}
+
+qint64 NamePool::GetUsedBytes() const
+{
+  return m_usedBytes;
+}
+
+quint64 NamePool::GetFailedCount() const
+{
+  return m_failedCount;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// Position of an interned name in NamePool
+struct NameRef
+{
+  quint32 m_offset = 0;
+  quint16 m_length = 0;
+};
+
+/// Append-only UTF-16 storage for entry names, shared by all nodes of a model.
+/// Every distinct name is stored once, interning it again returns the same reference.
+/// Scanner threads intern names under a writer-only mutex. Readers never lock:
+/// blocks never move, and a reference reaches another thread only through a queued
+/// signal emitted after Intern returned, which orders the write before the read.
+class NamePool
+{
+public:
+  NamePool();
+  ~NamePool();
+
+  /// False when the pool is full, the name is not stored then and ref is left as is
+  bool Intern(QString const & name, NameRef & ref);
+  bool Intern(QChar const * data, int length, NameRef & ref);
+
+  QString Get(NameRef ref) const;
+  QChar const * Data(NameRef ref) const;
+
+  /// Code unit order, the same as QString::operator <
+  int Compare(NameRef l, NameRef r) const;
+  int Compare(NameRef l, QString const & r) const;
+  /// Names of different pools
+  static int CompareUnits(QChar const * l, int lLength, QChar const * r, int rLength);
+
+  /// Blocks and the lookup table
+  qint64 GetUsedBytes() const;
+  /// Names Intern refused because the pool was full
+  quint64 GetFailedCount() const;
+
+private:
+  static int const BlockBits = 16;
+  static quint32 const BlockSize = 1 << BlockBits;
+  static quint32 const MaxBlocks = 1 << 16;
+
+  static quint32 Hash(QChar const * data, int length);
+  /// Slot that holds the name, or the empty slot where it belongs
+  size_t FindSlot(QChar const * data, int length, quint32 hash) const;
+  void GrowTable();
+
+  std::unique_ptr<std::atomic<QChar *>[]> m_blocks;
+
+  QMutex m_writeMutex;
+  /// guarded by m_writeMutex
+  quint64 m_used = 0;
+  /// open addressing by name, empty slots have length 0; guarded by m_writeMutex
+  std::vector<NameRef> m_table;
+  size_t m_nameCount = 0;
+
+  std::atomic<qint64> m_usedBytes;
+  std::atomic<quint64> m_failedCount;
+};
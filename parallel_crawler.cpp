@@ -0,0 +1,441 @@
+#include "parallel_crawler.hpp"
+#include "entry_info.hpp"
+#include "file_stat.hpp"
+
+#include <QDateTime>
+#include <QMutex>
+#include <QPair>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+/// Milliseconds between progress reports
+int const ProgressInterval = 500;
+
+/// Longer suffixes are parts of names rather than file types
+int const MaxExtensionLength = 16;
+
+qint64 const DayMSecs = 24 * 60 * 60 * 1000LL;
+
+/// Locks of the visited set, many more than workers so two of them rarely meet on one
+size_t const VisitedShardCount = 64;
+
+struct CrawlDir
+{
+  QString m_path;
+  QString m_relativePath;
+  TIgnoreRules m_rules;
+  /// from the listing of the parent, so a directory is not stat'ed twice
+  FileStat m_stat;
+};
+
+/// Directories waiting to be listed, shared by the workers of one crawl
+class DirQueue
+{
+public:
+  void Push(std::vector<CrawlDir> && dirs)
+  {
+    QMutexLocker lock(&m_mutex);
+    for (CrawlDir & dir : dirs)
+      m_dirs.push_back(std::move(dir));
+    m_condition.wakeAll();
+  }
+
+  /// Waits while other workers may still find directories, false when the crawl is over
+  bool Pop(CrawlDir & dir)
+  {
+    QMutexLocker lock(&m_mutex);
+    while (m_dirs.empty() && m_busyCount > 0 && !m_isCanceled)
+      m_condition.wait(&m_mutex);
+
+    if (m_dirs.empty() || m_isCanceled)
+      return false;
+
+    dir = std::move(m_dirs.front());
+    m_dirs.pop_front();
+    ++m_busyCount;
+    return true;
+  }
+
+  /// The popped directory is listed and its subdirectories are pushed
+  void Done()
+  {
+    QMutexLocker lock(&m_mutex);
+    if (--m_busyCount == 0 && m_dirs.empty())
+      m_condition.wakeAll();
+  }
+
+  void Cancel()
+  {
+    QMutexLocker lock(&m_mutex);
+    m_isCanceled = true;
+    m_condition.wakeAll();
+  }
+
+private:
+  QMutex m_mutex;
+  QWaitCondition m_condition;
+  std::deque<CrawlDir> m_dirs;
+  int m_busyCount = 0;
+  bool m_isCanceled = false;
+};
+
+/// Device and inode of every directory listed and of every file with several names,
+/// shared by the workers of one crawl
+class VisitedSet
+{
+public:
+  /// False when the entry was inserted before
+  bool Insert(FileStat const & stat)
+  {
+    // inodes are handed out in sequence, so their low bits spread the entries evenly
+    Shard & shard = m_shards[(stat.m_inode ^ stat.m_device) % VisitedShardCount];
+    QMutexLocker lock(&shard.m_mutex);
+    int const size = shard.m_ids.size();
+    shard.m_ids.insert(qMakePair(stat.m_device, stat.m_inode));
+    return shard.m_ids.size() != size;
+  }
+
+private:
+  struct Shard
+  {
+    QMutex m_mutex;
+    QSet<QPair<quint64, quint64> > m_ids;
+  };
+
+  std::array<Shard, VisitedShardCount> m_shards;
+};
+
+CrawlStats::EAge GetAge(qint64 modifiedTime, qint64 now)
+{
+  if (modifiedTime == EntryInfo::InvalidTime)
+    return CrawlStats::UnknownAge;
+
+  qint64 const days = (now - modifiedTime) / DayMSecs;
+  if (days < 1)
+    return CrawlStats::Day;
+  if (days < 7)
+    return CrawlStats::Week;
+  if (days < 30)
+    return CrawlStats::Month;
+  if (days < 91)
+    return CrawlStats::Quarter;
+  if (days < 365)
+    return CrawlStats::Year;
+  if (days < 3 * 365)
+    return CrawlStats::ThreeYears;
+
+  return CrawlStats::Older;
+}
+
+/// Counts a file in the extension histogram without a string allocation per file
+void AddExtension(QHash<QString, StatsBucket> & byExtension, QString const & name, qint64 size)
+{
+  // a leading dot marks a hidden file, not a suffix
+  int const dot = name.lastIndexOf('.');
+  int const length = dot > 0 ? name.size() - dot - 1 : 0;
+  if (length > MaxExtensionLength)
+  {
+    byExtension[QString()].Add(size);
+    return;
+  }
+
+  QChar suffix[MaxExtensionLength];
+  for (int i = 0; i < length; ++i)
+    suffix[i] = name[dot + 1 + i].toLower();
+
+  QString const key = QString::fromRawData(suffix, length);
+  QHash<QString, StatsBucket>::iterator it = byExtension.find(key);
+  if (it == byExtension.end())
+    it = byExtension.insert(QString(suffix, length), StatsBucket());
+  it->Add(size);
+}
+
+class CrawlWorker : public QRunnable
+{
+public:
+  CrawlWorker(DirQueue & queue, VisitedSet & visited, CrawlRoot const & root, quint64 rootDevice, qint64 now,
+              std::atomic<bool> const & canceled)
+    : m_queue(queue)
+    , m_visited(visited)
+    , m_root(root)
+    , m_rootDevice(rootDevice)
+    , m_now(now)
+    , m_canceled(canceled)
+  {
+  }
+
+  /// Copy of the histograms filled so far, taken while the worker runs
+  CrawlStats GetStats()
+  {
+    QMutexLocker lock(&m_statsMutex);
+    return m_stats;
+  }
+
+protected:
+  void run()
+  {
+    CrawlDir dir;
+    while (m_queue.Pop(dir))
+    {
+      ListDir(dir);
+      m_queue.Done();
+    }
+  }
+
+private:
+  void ListDir(CrawlDir const & dir)
+  {
+    // the listing of the parent has no identity without Unix, one stat per directory finds it
+    FileStat dirStat = dir.m_stat;
+    if (dirStat.m_inode == 0 && !ReadFileStat(dir.m_path, dirStat))
+    {
+      QMutexLocker lock(&m_statsMutex);
+      ++m_stats.m_errorCount;
+      return;
+    }
+
+    if (m_root.m_sameDevice && dirStat.m_device != m_rootDevice)
+    {
+      QMutexLocker lock(&m_statsMutex);
+      ++m_stats.m_skippedMounts;
+      return;
+    }
+
+    if (!m_visited.Insert(dirStat))
+    {
+      QMutexLocker lock(&m_statsMutex);
+      ++m_stats.m_revisitedDirs;
+      return;
+    }
+
+    DirLister lister(dir.m_path);
+    if (!lister.IsOpen())
+    {
+      QMutexLocker lock(&m_statsMutex);
+      ++m_stats.m_errorCount;
+      return;
+    }
+
+    TIgnoreRules rules = dir.m_rules;
+    if (m_root.m_readGitIgnore)
+      rules = ReadGitIgnore(rules, dir.m_path, dir.m_relativePath);
+
+    QString const prefix = dir.m_path.endsWith('/') ? dir.m_path : dir.m_path + '/';
+    std::vector<CrawlDir> subdirs;
+    StatsBucket ownFiles;
+    ListedEntry listed;
+    while (m_canceled == false && lister.Next(listed))
+    {
+      // paths are built only for subdirectories and top list entries
+      QString const fileName = QString::fromRawData(listed.m_name, listed.m_nameLength);
+      FileStat const & fileStat = listed.m_stat;
+      bool const isDir = fileStat.m_isDir;
+      if (rules != nullptr && rules->IsExcluded(dir.m_relativePath, fileName, isDir))
+        continue;
+
+      if (listed.m_isSymLink && (!m_root.m_followSymLinks || listed.m_isDangling))
+      {
+        QMutexLocker lock(&m_statsMutex);
+        ++m_stats.m_skippedLinks;
+        continue;
+      }
+
+      // the identity of a directory is checked when it is listed
+      if (isDir)
+      {
+        QString const relativePath = dir.m_relativePath.isEmpty() ? fileName : dir.m_relativePath + '/' + fileName;
+        subdirs.push_back(CrawlDir{ prefix + fileName, relativePath, rules, fileStat });
+        continue;
+      }
+
+      EntryInfo const entry = MakeEntryInfo(fileStat, listed.m_isSymLink);
+      // a file with one name is only reached once unless links are followed, so it stays out of the set,
+      // without an identity nothing can be told apart
+      bool const isDuplicate = fileStat.m_inode != 0 && (m_root.m_followSymLinks || fileStat.m_linkCount > 1) &&
+                               !m_visited.Insert(fileStat);
+      QMutexLocker lock(&m_statsMutex);
+      if (isDuplicate)
+      {
+        m_stats.m_duplicates.Add(entry.m_size);
+        continue;
+      }
+
+      ownFiles.Add(entry.m_size);
+      m_stats.m_total.Add(entry.m_size);
+      m_stats.m_byOwner[entry.m_ownerId].Add(entry.m_size);
+      m_stats.m_byAge[GetAge(entry.m_modifiedTime, m_now)].Add(entry.m_size);
+      AddExtension(m_stats.m_byExtension, fileName, entry.m_size);
+      for (TopList * top : { &m_stats.m_largestFiles, &m_stats.m_oldestFiles })
+      {
+        if (top->Accepts(entry.m_size, entry.m_modifiedTime))
+          top->Add(TopEntry{ prefix + fileName, 1, entry.m_size, entry.m_modifiedTime });
+      }
+    }
+
+    {
+      QMutexLocker lock(&m_statsMutex);
+      ++m_stats.m_dirCount;
+      if (ownFiles.m_count > 0 && m_stats.m_largestDirs.Accepts(ownFiles.m_size, EntryInfo::InvalidTime))
+        m_stats.m_largestDirs.Add(TopEntry{ dir.m_path, ownFiles.m_count, ownFiles.m_size, EntryInfo::InvalidTime });
+    }
+
+    m_queue.Push(std::move(subdirs));
+  }
+
+  DirQueue & m_queue;
+  VisitedSet & m_visited;
+  CrawlRoot const & m_root;
+  quint64 m_rootDevice;
+  qint64 m_now;
+  std::atomic<bool> const & m_canceled;
+
+  /// locked per file, the owning thread is the only writer so the lock is never contended for long
+  QMutex m_statsMutex;
+  CrawlStats m_stats;
+};
+
+CrawlStats CollectStats(std::vector<std::unique_ptr<CrawlWorker> > const & workers)
+{
+  CrawlStats stats;
+  for (std::unique_ptr<CrawlWorker> const & worker : workers)
+    stats.Merge(worker->GetStats());
+
+  return stats;
+}
+
+} // namespace
+
+TopList::TopList(EKey key, size_t capacity)
+  : m_key(key)
+  , m_capacity(capacity)
+{
+}
+
+bool TopList::Accepts(qint64 size, qint64 modifiedTime) const
+{
+  if (m_key == OldestTime && modifiedTime == EntryInfo::InvalidTime)
+    return false;
+
+  if (m_heap.size() < m_capacity)
+    return true;
+
+  TopEntry candidate = TopEntry();
+  candidate.m_size = size;
+  candidate.m_modifiedTime = modifiedTime;
+  return IsBetter(candidate, m_heap.front());
+}
+
+void TopList::Add(TopEntry const & entry)
+{
+  // the heap keeps the worst entry in front
+  auto isWorse = [this](TopEntry const & l, TopEntry const & r) { return IsBetter(l, r); };
+  if (m_heap.size() == m_capacity)
+  {
+    std::pop_heap(m_heap.begin(), m_heap.end(), isWorse);
+    m_heap.pop_back();
+  }
+
+  m_heap.push_back(entry);
+  std::push_heap(m_heap.begin(), m_heap.end(), isWorse);
+}
+
+void TopList::Merge(TopList const & other)
+{
+  for (TopEntry const & entry : other.m_heap)
+  {
+    if (Accepts(entry.m_size, entry.m_modifiedTime))
+      Add(entry);
+  }
+}
+
+std::vector<TopEntry> TopList::Sorted() const
+{
+  std::vector<TopEntry> sorted(m_heap);
+  std::sort(sorted.begin(), sorted.end(), [this](TopEntry const & l, TopEntry const & r) { return IsBetter(l, r); });
+  return sorted;
+}
+
+bool TopList::IsBetter(TopEntry const & l, TopEntry const & r) const
+{
+  if (m_key == OldestTime)
+    return l.m_modifiedTime < r.m_modifiedTime;
+
+  return l.m_size > r.m_size;
+}
+
+void CrawlStats::Merge(CrawlStats const & other)
+{
+  for (QHash<QString, StatsBucket>::const_iterator it = other.m_byExtension.begin(); it != other.m_byExtension.end(); ++it)
+    m_byExtension[it.key()].Merge(it.value());
+  for (QHash<uint, StatsBucket>::const_iterator it = other.m_byOwner.begin(); it != other.m_byOwner.end(); ++it)
+    m_byOwner[it.key()].Merge(it.value());
+  for (size_t i = 0; i < m_byAge.size(); ++i)
+    m_byAge[i].Merge(other.m_byAge[i]);
+
+  m_total.Merge(other.m_total);
+  m_largestFiles.Merge(other.m_largestFiles);
+  m_oldestFiles.Merge(other.m_oldestFiles);
+  m_largestDirs.Merge(other.m_largestDirs);
+  m_dirCount += other.m_dirCount;
+  m_errorCount += other.m_errorCount;
+  m_skippedLinks += other.m_skippedLinks;
+  m_skippedMounts += other.m_skippedMounts;
+  m_revisitedDirs += other.m_revisitedDirs;
+  m_duplicates.Merge(other.m_duplicates);
+}
+
+ParallelCrawler::ParallelCrawler(CrawlRoot const & root)
+  : m_root(root)
+  , m_canceled(false)
+{
+}
+
+void ParallelCrawler::cancel()
+{
+  m_canceled = true;
+}
+
+void ParallelCrawler::run()
+{
+  FileStat rootStat;
+  ReadFileStat(m_root.m_path, rootStat);
+  DirQueue queue;
+  queue.Push(std::vector<CrawlDir>(1, CrawlDir{ m_root.m_path, m_root.m_relativePath, m_root.m_rules, rootStat }));
+
+  // listing waits on the disk as much as on the CPU, so one thread per core keeps both busy
+  int const threadCount = std::max(2, QThread::idealThreadCount());
+  qint64 const now = QDateTime::currentMSecsSinceEpoch();
+  VisitedSet visited;
+  QThreadPool pool;
+  pool.setMaxThreadCount(threadCount);
+  std::vector<std::unique_ptr<CrawlWorker> > workers;
+  for (int i = 0; i < threadCount; ++i)
+  {
+    workers.emplace_back(new CrawlWorker(queue, visited, m_root, rootStat.m_device, now, m_canceled));
+    workers.back()->setAutoDelete(false);
+    pool.start(workers.back().get());
+  }
+
+  while (!pool.waitForDone(ProgressInterval))
+  {
+    if (m_canceled == true)
+    {
+      queue.Cancel();
+      continue;
+    }
+
+    emit progress(CollectStats(workers), false, this);
+  }
+
+  emit progress(CollectStats(workers), true, this);
+}
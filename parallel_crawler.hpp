@@ -0,0 +1,147 @@
+#pragma once
+
+#include "ignore_rules.hpp"
+
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+/// Where a crawl starts and the exclusion rules that apply below it
+struct CrawlRoot
+{
+  QString m_path;
+  /// m_path relative to the root the rules belong to
+  QString m_relativePath;
+  TIgnoreRules m_rules;
+  bool m_readGitIgnore = false;
+  /// directories on other file systems are counted as skipped mount points
+  bool m_sameDevice = false;
+  /// linked directories are listed unless they were listed before, linked files are counted where they point
+  bool m_followSymLinks = false;
+};
+
+struct StatsBucket
+{
+  quint64 m_count = 0;
+  qint64 m_size = 0;
+
+  void Add(qint64 size)
+  {
+    ++m_count;
+    m_size += size;
+  }
+
+  void Merge(StatsBucket const & other)
+  {
+    m_count += other.m_count;
+    m_size += other.m_size;
+  }
+};
+
+/// File or directory of a top list
+struct TopEntry
+{
+  QString m_path;
+  /// files directly inside for directories, 1 for files
+  quint64 m_count;
+  qint64 m_size;
+  qint64 m_modifiedTime;
+};
+
+/// The capacity best entries by one key. The worst kept entry is on top of a heap,
+/// so most candidates are rejected by one comparison before their path is built.
+class TopList
+{
+public:
+  enum EKey
+  {
+    LargestSize,
+    OldestTime
+  };
+
+  explicit TopList(EKey key, size_t capacity = 100);
+
+  bool Accepts(qint64 size, qint64 modifiedTime) const;
+  void Add(TopEntry const & entry);
+  void Merge(TopList const & other);
+  /// Best first
+  std::vector<TopEntry> Sorted() const;
+
+private:
+  bool IsBetter(TopEntry const & l, TopEntry const & r) const;
+
+  EKey m_key;
+  size_t m_capacity;
+  std::vector<TopEntry> m_heap;
+};
+
+/// Histograms of the files below a directory. Every worker fills its own, they are merged for reports.
+struct CrawlStats
+{
+  /// by the time since the last modification
+  enum EAge
+  {
+    Day,
+    Week,
+    Month,
+    Quarter,
+    Year,
+    ThreeYears,
+    Older,
+    UnknownAge,
+    AgeCount
+  };
+
+  /// lower case suffix behind the last dot, "" for files without one
+  QHash<QString, StatsBucket> m_byExtension;
+  QHash<uint, StatsBucket> m_byOwner;
+  std::array<StatsBucket, AgeCount> m_byAge;
+  StatsBucket m_total;
+  TopList m_largestFiles = TopList(TopList::LargestSize);
+  TopList m_oldestFiles = TopList(TopList::OldestTime);
+  /// by the size of the files directly inside, subtree totals would need the whole tree in memory
+  TopList m_largestDirs = TopList(TopList::LargestSize);
+  quint64 m_dirCount = 0;
+  /// directories that could not be listed
+  quint64 m_errorCount = 0;
+  /// links that were not followed
+  quint64 m_skippedLinks = 0;
+  /// directories on another file system
+  quint64 m_skippedMounts = 0;
+  /// directories reached a second time through a link, a bind mount or a loop
+  quint64 m_revisitedDirs = 0;
+  /// further names of hard linked files, their data is counted under the first name only
+  StatsBucket m_duplicates;
+
+  void Merge(CrawlStats const & other);
+};
+
+Q_DECLARE_METATYPE(CrawlStats)
+
+/// Lists a whole subtree from disk with a thread per core, the workers share one queue of directories.
+/// Directories and hard linked files are told apart by device and inode, so each is counted once.
+class ParallelCrawler : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  explicit ParallelCrawler(CrawlRoot const & root);
+
+  void cancel();
+
+  /// About twice a second while the crawl runs and once with finished set at the end
+  Q_SIGNAL void progress(CrawlStats const & stats, bool finished, ParallelCrawler * crawler);
+
+protected:
+  void run();
+
+private:
+  CrawlRoot m_root;
+  std::atomic<bool> m_canceled;
+};
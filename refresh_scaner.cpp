@@ -0,0 +1,72 @@
+#include "refresh_scaner.hpp"
+
+#include <QDirIterator>
+
+RefreshScaner::RefreshScaner(std::vector<RefreshItem> && items, std::shared_ptr<NamePool> const & pool)
+  : m_items(std::move(items))
+  , m_pool(pool)
+  , m_canceled(false)
+  , m_processedCount(0)
+{
+}
+
+void RefreshScaner::run()
+{
+  for (RefreshItem const & item : m_items)
+  {
+    if (m_canceled == true)
+      break;
+
+    // entries are added, removed or renamed only through the directory itself,
+    // so unchanged stamps mean the listing can be kept as is
+    ++m_processedCount;
+    DirListing listing;
+    listing.m_token = item.m_token;
+    if (ReadFileStat(item.m_path, listing.m_stat) && listing.m_stat == item.m_stat)
+      continue;
+
+    QDirIterator iter(item.m_path);
+    while (iter.hasNext())
+    {
+      if (m_canceled == true)
+        break;
+
+      iter.next();
+      QString fileName = iter.fileName();
+      if (fileName == "." || fileName == "..")
+        continue;
+
+      ++m_processedCount;
+      QFileInfo const info = iter.fileInfo();
+      if (item.m_rules != nullptr && item.m_rules->IsExcluded(item.m_relativePath, fileName, info.isDir()))
+        continue;
+
+      EntryInfo entry;
+      if (MakeEntryInfo(info, fileName, *m_pool, entry))
+        listing.m_entries.push_back(entry);
+    }
+
+    if (m_canceled == true)
+      break;
+
+    emit dirChanged(listing, this);
+  }
+
+  reportMeasured();
+  emit refreshFinished(this);
+}
+
+void RefreshScaner::cancel()
+{
+  m_canceled = true;
+}
+
+quint64 RefreshScaner::processedCount() const
+{
+  return m_processedCount;
+}
+
+bool RefreshScaner::isCanceled() const
+{
+  return m_canceled;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "entry_info.hpp"
+#include "file_stat.hpp"
+#include "ignore_rules.hpp"
+#include "scan_scheduler.hpp"
+
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// Directory that was scanned before, with the stamps it had at that moment
+struct RefreshItem
+{
+  void * m_token = nullptr;
+  QString m_path;
+  FileStat m_stat;
+  /// same rules the directory was scanned with, a changed .gitignore is picked up by a new scan
+  QString m_relativePath;
+  TIgnoreRules m_rules;
+};
+
+/// Fresh listing of a directory whose stamps no longer match
+struct DirListing
+{
+  void * m_token = nullptr;
+  FileStat m_stat;
+  std::vector<EntryInfo> m_entries;
+};
+
+Q_DECLARE_METATYPE(DirListing)
+
+class RefreshScaner : public QObject, public ScanTask
+{
+  Q_OBJECT
+
+public:
+  RefreshScaner(std::vector<RefreshItem> && items, std::shared_ptr<NamePool> const & pool);
+
+  Q_SIGNAL void dirChanged(DirListing const & listing, RefreshScaner * scaner);
+  Q_SIGNAL void refreshFinished(RefreshScaner * scaner);
+
+  void cancel();
+
+  quint64 processedCount() const override;
+  bool isCanceled() const override;
+
+protected:
+  void run();
+
+private:
+  std::vector<RefreshItem> m_items;
+  std::shared_ptr<NamePool> m_pool;
+  std::atomic<bool> m_canceled;
+  std::atomic<quint64> m_processedCount;
+};
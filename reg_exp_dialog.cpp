@@ -2,11 +2,24 @@
 #include "ui_regexpdialog.h"
 
 #include "macros.hpp"
+#include "name_matcher.hpp"
 
-RegExpDialog::RegExpDialog(QRegExp const & initExp, QWidget * parent)
+#include <QThreadPool>
+
+namespace
+{
+
+/// Matching names listed under the count
+int const SampleSize = 20;
+
+} // namespace
+
+RegExpDialog::RegExpDialog(QRegExp const & initExp, std::shared_ptr<NameList const> const & names, QWidget * parent)
   : TBase(parent)
   , m_ui(new Ui::RegExpDialog)
   , m_regExp(initExp)
+  , m_names(names)
+  , m_matcher(nullptr)
 {
   m_ui->setupUi(this);
   setModal(true);
@@ -24,6 +37,10 @@ RegExpDialog::RegExpDialog(QRegExp const & initExp, QWidget * parent)
 
 RegExpDialog::~RegExpDialog()
 {
+  // a running matcher deletes itself when it stops
+  if (m_matcher != nullptr)
+    m_matcher->cancel();
+
   delete m_ui;
 }
 
@@ -36,6 +53,7 @@ void RegExpDialog::regExpChanged()
 {
   m_regExp.setPattern(m_ui->m_regExpEditor->text());
   updateResult();
+  updatePreview();
 }
 
 void RegExpDialog::tryTextChanged()
@@ -57,3 +75,39 @@ void RegExpDialog::updateResult()
   }
 }
 
+void RegExpDialog::updatePreview()
+{
+  if (m_matcher != nullptr)
+    m_matcher->cancel();
+  m_matcher = nullptr;
+
+  if (m_names == nullptr || !m_regExp.isValid())
+  {
+    m_ui->m_matchCount->clear();
+    m_ui->m_matchSample->clear();
+    return;
+  }
+
+  m_matcher = new NameMatcher(m_names, m_regExp, SampleSize);
+  VERIFY(QObject::connect(m_matcher, &NameMatcher::matchFinished,
+                          this, &RegExpDialog::matchFinished, Qt::QueuedConnection));
+  // canceled matchers are deleted as well, their result is no longer wanted by anyone
+  VERIFY(QObject::connect(m_matcher, &NameMatcher::matchFinished,
+                          m_matcher, &QObject::deleteLater, Qt::QueuedConnection));
+  m_matcher->setAutoDelete(false);
+  QThreadPool::globalInstance()->start(m_matcher);
+
+  m_ui->m_matchCount->setText(QStringLiteral("counting..."));
+}
+
+void RegExpDialog::matchFinished(MatchResult const & result, bool canceled, NameMatcher * matcher)
+{
+  if (canceled || matcher != m_matcher)
+    return;
+
+  m_matcher = nullptr;
+  m_ui->m_matchCount->setText(QStringLiteral("%1 of %2 loaded names (%3 ms)")
+                              .arg(result.m_matchCount).arg(result.m_nameCount).arg(result.m_elapsedMSecs));
+  m_ui->m_matchSample->clear();
+  m_ui->m_matchSample->addItems(result.m_sample);
+}
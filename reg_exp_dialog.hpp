@@ -3,6 +3,8 @@
 #include <QDialog>
 #include <QRegExp>
 
+#include <memory>
+
 namespace Ui
 {
 
@@ -10,11 +12,16 @@ class RegExpDialog;
 
 } //namespace Ui
 
+class NameMatcher;
+struct MatchResult;
+struct NameList;
+
 class RegExpDialog : public QDialog
 {
   using TBase = QDialog;
 public:
-  RegExpDialog(QRegExp const & initExp, QWidget * parent);
+  /// names are the loaded entries the preview counts matches in
+  RegExpDialog(QRegExp const & initExp, std::shared_ptr<NameList const> const & names, QWidget * parent);
   ~RegExpDialog();
 
   QRegExp const & GetRegExp() const;
@@ -22,10 +29,15 @@ public:
 private:
   Q_SLOT void regExpChanged();
   Q_SLOT void tryTextChanged();
+  Q_SLOT void matchFinished(MatchResult const & result, bool canceled, NameMatcher * matcher);
 
   void updateResult();
+  /// Restarts the count in the background, the previous one is canceled
+  void updatePreview();
 
 private:
   Ui::RegExpDialog * m_ui;
   QRegExp m_regExp;
+  std::shared_ptr<NameList const> m_names;
+  NameMatcher * m_matcher;
 };
@@ -0,0 +1,197 @@
+#include "scan_scheduler.hpp"
+#include "macros.hpp"
+
+#include <QStringList>
+
+namespace
+{
+
+int const InitialLimit = 4;
+int const MaxLimit = 32;
+/// a window is closed after this time and at least limit finished tasks
+qint64 const WindowTime = 500;
+double const Tolerance = 0.1;
+
+/// Measures the wrapped task on the pool thread and reports back to the scheduler
+class MeasuredTask : public QRunnable
+{
+public:
+  MeasuredTask(ScanTask * task, quint64 device, std::function<void (quint64, quint64, qint64, bool)> const & done)
+    : m_task(task)
+    , m_device(device)
+    , m_done(done)
+  {
+    setAutoDelete(true);
+  }
+
+  void run()
+  {
+    // a task that is not autoDelete may be deleted by its owner as soon as run returns,
+    // so its counts arrive through reportMeasured
+    bool const isOwned = m_task->autoDelete();
+    quint64 processedCount = 0;
+    bool measured = false;
+    m_task->setMeasured([&processedCount, &measured](quint64 count, bool canceled)
+    {
+      processedCount = count;
+      measured = !canceled;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    m_task->run();
+
+    qint64 const elapsed = timer.nsecsElapsed() / 1000;
+    if (isOwned)
+      delete m_task;
+
+    m_done(m_device, processedCount, elapsed, measured);
+  }
+
+private:
+  ScanTask * m_task;
+  quint64 m_device;
+  std::function<void (quint64, quint64, qint64, bool)> m_done;
+};
+
+} // namespace
+
+ScanScheduler::ScanScheduler(QObject * parent)
+  : QObject(parent)
+{
+  // threads mostly wait on I/O, the per device limits decide how many of them run
+  m_pool.setMaxThreadCount(MaxLimit * 2);
+  VERIFY(QObject::connect(this, &ScanScheduler::taskDone,
+                          this, &ScanScheduler::onTaskDone, Qt::QueuedConnection));
+}
+
+ScanScheduler::~ScanScheduler()
+{
+  // tasks that never started are deleted whatever their autoDelete, the finish signal
+  // their owner waits for to delete them never comes
+  for (auto & device : m_devices)
+  {
+    for (ScanTask * task : device.second.m_queue)
+      delete task;
+  }
+
+  m_devices.clear();
+  m_pool.waitForDone();
+}
+
+void ScanScheduler::start(ScanTask * task, quint64 device)
+{
+  DeviceState & state = m_devices[device];
+  if (state.m_limit == 0)
+  {
+    state.m_limit = InitialLimit;
+    state.m_windowTimer.start();
+  }
+
+  state.m_queue.push_back(task);
+  StartQueued(device, state);
+}
+
+void ScanScheduler::StartQueued(quint64 device, DeviceState & state)
+{
+  while (state.m_running < state.m_limit && !state.m_queue.empty())
+  {
+    ScanTask * task = state.m_queue.front();
+    state.m_queue.pop_front();
+    ++state.m_running;
+
+    // the signal is emitted on the pool thread and delivered to the scheduler thread
+    m_pool.start(new MeasuredTask(task, device, [this](quint64 device, quint64 processedCount,
+                                                       qint64 elapsedUsec, bool measured)
+    {
+      emit taskDone(device, processedCount, elapsedUsec, measured);
+    }));
+  }
+
+  if (!state.m_queue.empty())
+    state.m_isSaturated = true;
+}
+
+void ScanScheduler::onTaskDone(quint64 device, quint64 processedCount, qint64 elapsedUsec, bool measured)
+{
+  std::map<quint64, DeviceState>::iterator it = m_devices.find(device);
+  if (it == m_devices.end())
+    return;
+
+  DeviceState & state = it->second;
+  --state.m_running;
+
+  if (measured)
+  {
+    // an empty directory is still one listing
+    ++state.m_totalTasks;
+    state.m_totalCount += processedCount;
+    ++state.m_windowTasks;
+    state.m_windowCount += processedCount + 1;
+    state.m_windowLatency += elapsedUsec;
+  }
+
+  if (state.m_windowTimer.elapsed() >= WindowTime && state.m_windowTasks >= static_cast<quint64>(state.m_limit))
+    Adjust(state);
+
+  StartQueued(device, state);
+}
+
+void ScanScheduler::Adjust(DeviceState & state)
+{
+  double const throughput = state.m_windowCount * 1000.0 / std::max<qint64>(1, state.m_windowTimer.elapsed());
+  double const latency = static_cast<double>(state.m_windowLatency) / state.m_windowTasks;
+
+  if (state.m_isSaturated)
+  {
+    if (state.m_lastThroughput == 0)
+    {
+      // first measurement, probe in the current direction
+    }
+    else if (throughput < state.m_lastThroughput * (1 - Tolerance))
+      state.m_direction = -state.m_direction;
+    else if (throughput < state.m_lastThroughput * (1 + Tolerance))
+    {
+      // plateau, extra threads only add latency: seek thrash on a disk, queueing on a server
+      if (latency > state.m_lastLatency * (1 + Tolerance))
+        state.m_direction = -1;
+      else
+        state.m_direction = 0;
+    }
+
+    state.m_limit = std::min(MaxLimit, std::max(1, state.m_limit + state.m_direction));
+    if (state.m_direction == 0)
+      state.m_direction = 1;
+
+    state.m_lastThroughput = throughput;
+    state.m_lastLatency = latency;
+  }
+
+  state.m_isSaturated = !state.m_queue.empty();
+  state.m_windowTimer.restart();
+  state.m_windowCount = 0;
+  state.m_windowTasks = 0;
+  state.m_windowLatency = 0;
+}
+
+QString ScanScheduler::diagnostics() const
+{
+  QStringList lines;
+  for (auto const & device : m_devices)
+  {
+    DeviceState const & state = device.second;
+    lines.append(QStringLiteral("device %1: limit %2, running %3, queued %4, %5 entries/s, %6 ms per listing, %7 listings")
+                 .arg(device.first, 0, 16)
+                 .arg(state.m_limit)
+                 .arg(state.m_running)
+                 .arg(static_cast<int>(state.m_queue.size()))
+                 .arg(state.m_lastThroughput, 0, 'f', 0)
+                 .arg(state.m_lastLatency / 1000, 0, 'f', 1)
+                 .arg(state.m_totalTasks));
+  }
+
+  if (lines.isEmpty())
+    return QStringLiteral("No scans yet");
+
+  return lines.join('\n');
+}
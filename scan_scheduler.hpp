@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <deque>
+#include <functional>
+#include <map>
+
+/// Runnable that tells the scheduler how much it did, directories and entries alike
+class ScanTask : public QRunnable
+{
+public:
+  using TMeasured = std::function<void (quint64 processedCount, bool canceled)>;
+
+  virtual quint64 processedCount() const = 0;
+  /// canceled runs are not measured
+  virtual bool isCanceled() const = 0;
+
+  /// Set by the scheduler before the task runs
+  void setMeasured(TMeasured const & measured)
+  {
+    m_measured = measured;
+  }
+
+protected:
+  /// Hands the counts to the scheduler. Called right before the last signal of run,
+  /// the receiver of that signal may delete a task that is not autoDelete.
+  void reportMeasured()
+  {
+    if (m_measured)
+      m_measured(processedCount(), isCanceled());
+  }
+
+private:
+  TMeasured m_measured;
+};
+
+/// Runs scan tasks grouped by the device they read from. Every device has its own
+/// concurrency limit, tuned by hill climbing on the measured entries per second:
+/// a spinning disk settles low, a high latency network mount climbs high.
+class ScanScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+  ScanScheduler(QObject * parent = 0);
+  ~ScanScheduler();
+
+  /// Takes the task the same way QThreadPool does, autoDelete tasks are deleted after they ran.
+  /// The task is not touched after its run returned unless it is autoDelete.
+  void start(ScanTask * task, quint64 device);
+
+  /// Limits, queue lengths and measured rates per device
+  QString diagnostics() const;
+
+private:
+  Q_SIGNAL void taskDone(quint64 device, quint64 processedCount, qint64 elapsedUsec, bool measured);
+  Q_SLOT void onTaskDone(quint64 device, quint64 processedCount, qint64 elapsedUsec, bool measured);
+
+  struct DeviceState
+  {
+    std::deque<ScanTask *> m_queue;
+    int m_running = 0;
+    int m_limit = 0;
+    /// +1 while more threads helped, -1 after they did not
+    int m_direction = 1;
+
+    /// the window is measured only while tasks were waiting, otherwise the limit was not the bottleneck
+    bool m_isSaturated = false;
+    QElapsedTimer m_windowTimer;
+    quint64 m_windowCount = 0;
+    quint64 m_windowTasks = 0;
+    qint64 m_windowLatency = 0;
+    double m_lastThroughput = 0;
+    double m_lastLatency = 0;
+
+    quint64 m_totalTasks = 0;
+    quint64 m_totalCount = 0;
+  };
+
+  void StartQueued(quint64 device, DeviceState & state);
+  void Adjust(DeviceState & state);
+
+private:
+  QThreadPool m_pool;
+  std::map<quint64, DeviceState> m_devices;
+};
@@ -0,0 +1,149 @@
+#include "snapshot.hpp"
+
+#include <QDataStream>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace
+{
+
+quint32 const SnapshotMagic = 0x4C46534E;
+quint32 const SnapshotVersion = 2;
+
+/// Flags, size, time, child count and the length of an empty name
+qint64 const MinEntrySize = 1 + 8 + 8 + 4 + 4;
+
+} // namespace
+
+void SortSnapshot(ScanSnapshot & snapshot)
+{
+  if (snapshot.m_isSorted || snapshot.m_entries.empty())
+    return;
+
+  // positions in the unsorted entries, in the new level order
+  std::vector<quint32> order(1, 0);
+  order.reserve(snapshot.m_entries.size());
+  std::vector<SnapshotEntry> sorted;
+  sorted.reserve(snapshot.m_entries.size());
+  NamePool const & pool = *snapshot.m_pool;
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    SnapshotEntry entry = snapshot.m_entries[order[i]];
+    quint32 const firstChild = entry.m_firstChild;
+    entry.m_firstChild = static_cast<quint32>(order.size());
+    for (quint32 child = 0; child < entry.m_childCount; ++child)
+      order.push_back(firstChild + child);
+
+    std::sort(order.end() - entry.m_childCount, order.end(), [&snapshot, &pool](quint32 l, quint32 r)
+    {
+      return pool.Compare(snapshot.m_entries[l].m_name, snapshot.m_entries[r].m_name) < 0;
+    });
+    sorted.push_back(entry);
+  }
+
+  snapshot.m_entries.swap(sorted);
+  snapshot.m_isSorted = true;
+}
+
+bool SaveSnapshot(ScanSnapshot const & snapshot, QString const & path, QString & error)
+{
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << SnapshotMagic << SnapshotVersion << snapshot.m_rootPath
+         << static_cast<quint32>(snapshot.m_entries.size());
+
+  // ranges of children follow from the level order and the counts, they are not stored
+  NamePool const & pool = *snapshot.m_pool;
+  for (SnapshotEntry const & entry : snapshot.m_entries)
+  {
+    stream << entry.m_flags << entry.m_size << entry.m_modifiedTime << entry.m_childCount
+           << QString::fromRawData(pool.Data(entry.m_name), entry.m_name.m_length);
+  }
+
+  if (stream.status() != QDataStream::Ok || !file.commit())
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  return true;
+}
+
+bool LoadSnapshot(QString const & path, ScanSnapshot & snapshot, QString & error)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  quint32 count = 0;
+  stream >> magic >> version >> snapshot.m_rootPath >> count;
+  if (magic != SnapshotMagic || version != SnapshotVersion)
+  {
+    error = QStringLiteral("%1 is not a snapshot").arg(path);
+    return false;
+  }
+
+  snapshot.m_pool = std::make_shared<NamePool>();
+  snapshot.m_entries.clear();
+  // the count of a damaged header may be anything, the file cannot hold more entries than this
+  snapshot.m_entries.reserve(static_cast<size_t>(std::min<qint64>(count, file.size() / MinEntrySize)));
+
+  QString name;
+  quint64 nextChild = 1;
+  bool isDamaged = false;
+  for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok && !isDamaged; ++i)
+  {
+    SnapshotEntry entry;
+    stream >> entry.m_flags >> entry.m_size >> entry.m_modifiedTime >> entry.m_childCount >> name;
+    if (!snapshot.m_pool->Intern(name, entry.m_name))
+    {
+      error = QStringLiteral("%1 has more names than fit in memory").arg(path);
+      return false;
+    }
+
+    // children always follow their parent in level order, anything else would make a cycle
+    isDamaged = entry.m_childCount > 0 && nextChild <= i;
+    entry.m_firstChild = static_cast<quint32>(nextChild);
+    nextChild += entry.m_childCount;
+    snapshot.m_entries.push_back(entry);
+  }
+
+  if (stream.status() != QDataStream::Ok || isDamaged ||
+      nextChild != static_cast<quint64>(count) + (count == 0 ? 1 : 0))
+  {
+    error = QStringLiteral("%1 is damaged").arg(path);
+    return false;
+  }
+
+  return true;
+}
+
+SnapshotSaver::SnapshotSaver(std::shared_ptr<ScanSnapshot> const & snapshot, QString const & path)
+  : m_snapshot(snapshot)
+  , m_path(path)
+{
+}
+
+void SnapshotSaver::run()
+{
+  QString error;
+  SortSnapshot(*m_snapshot);
+  SaveSnapshot(*m_snapshot, m_path, error);
+  emit saveFinished(error, this);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "name_pool.hpp"
+
+#include <QObject>
+#include <QRunnable>
+#include <memory>
+#include <vector>
+
+/// Entry of a scan snapshot. Children of a directory are a contiguous range sorted by name,
+/// so two snapshots are compared by merging the ranges.
+struct SnapshotEntry
+{
+  enum EFlags
+  {
+    Dir = 1,
+    /// the directory was listed, a directory without it has unknown content
+    Listed = 2
+  };
+
+  NameRef m_name;
+  quint8 m_flags = 0;
+  qint64 m_size = 0;
+  /// milliseconds since epoch
+  qint64 m_modifiedTime = 0;
+  quint32 m_firstChild = 0;
+  quint32 m_childCount = 0;
+
+  bool IsDir() const
+  {
+    return (m_flags & Dir) != 0;
+  }
+
+  bool IsListed() const
+  {
+    return (m_flags & Listed) != 0;
+  }
+};
+
+/// Level order tree, entry 0 is the root
+struct ScanSnapshot
+{
+  std::shared_ptr<NamePool> m_pool;
+  QString m_rootPath;
+  std::vector<SnapshotEntry> m_entries;
+  /// snapshots of the live tree are taken in row order and sorted on a pool thread
+  bool m_isSorted = true;
+};
+
+/// Puts the children of every directory in name order, nothing is done for a sorted snapshot
+void SortSnapshot(ScanSnapshot & snapshot);
+/// The snapshot must be sorted
+bool SaveSnapshot(ScanSnapshot const & snapshot, QString const & path, QString & error);
+bool LoadSnapshot(QString const & path, ScanSnapshot & snapshot, QString & error);
+
+/// Writes a snapshot of the live tree on the thread pool
+class SnapshotSaver : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  SnapshotSaver(std::shared_ptr<ScanSnapshot> const & snapshot, QString const & path);
+
+  /// error is empty when the file was written
+  Q_SIGNAL void saveFinished(QString const & error, SnapshotSaver * saver);
+
+protected:
+  void run();
+
+private:
+  std::shared_ptr<ScanSnapshot> m_snapshot;
+  QString m_path;
+};
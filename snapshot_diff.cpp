@@ -0,0 +1,282 @@
+#include "snapshot_diff.hpp"
+
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+
+namespace
+{
+
+/// The first levels are compared sequentially until there are this many directory pairs per thread
+size_t const PairsPerThread = 4;
+
+struct DirPair
+{
+  quint32 m_old;
+  quint32 m_new;
+  /// node of the directory, children of the pair are added to it
+  DiffNode * m_diff;
+};
+
+class Differ
+{
+public:
+  Differ(ScanSnapshot const & oldSnapshot, ScanSnapshot const & newSnapshot)
+    : m_old(oldSnapshot)
+    , m_new(newSnapshot)
+  {
+  }
+
+  /// Merges children of two matched directories into diff. Matched listed subdirectories are
+  /// returned in pairs when it is given, otherwise they are compared right away.
+  void MergeChildren(quint32 oldIndex, quint32 newIndex, DiffNode * diff, std::vector<DirPair> * pairs) const
+  {
+    SnapshotEntry const & oldDir = m_old.m_entries[oldIndex];
+    SnapshotEntry const & newDir = m_new.m_entries[newIndex];
+    quint32 i = oldDir.m_firstChild;
+    quint32 j = newDir.m_firstChild;
+    quint32 const oldEnd = i + oldDir.m_childCount;
+    quint32 const newEnd = j + newDir.m_childCount;
+
+    while (i < oldEnd || j < newEnd)
+    {
+      int const order = i == oldEnd ? 1 : (j == newEnd ? -1 : CompareNames(i, j));
+      if (order < 0)
+      {
+        AddWhole(diff, m_old, i++, DiffNode::Removed);
+        continue;
+      }
+
+      if (order > 0)
+      {
+        AddWhole(diff, m_new, j++, DiffNode::Added);
+        continue;
+      }
+
+      SnapshotEntry const & oldEntry = m_old.m_entries[i];
+      SnapshotEntry const & newEntry = m_new.m_entries[j];
+      if (oldEntry.IsDir() != newEntry.IsDir())
+      {
+        AddWhole(diff, m_old, i, DiffNode::Removed);
+        AddWhole(diff, m_new, j, DiffNode::Added);
+      }
+      else if (oldEntry.IsDir())
+      {
+        if (oldEntry.IsListed() && newEntry.IsListed())
+        {
+          std::unique_ptr<DiffNode> child = MakeNode(m_new, j, DiffNode::Unchanged);
+          if (pairs != nullptr)
+          {
+            // kept even if nothing changes below it, empty nodes are dropped at the end
+            pairs->push_back(DirPair{ i, j, child.get() });
+            Append(diff, std::move(child));
+          }
+          else
+          {
+            MergeChildren(i, j, child.get(), nullptr);
+            if (!child->m_children.empty())
+              Append(diff, std::move(child));
+          }
+        }
+      }
+      else if (oldEntry.m_size != newEntry.m_size || oldEntry.m_modifiedTime != newEntry.m_modifiedTime)
+      {
+        std::unique_ptr<DiffNode> child = MakeNode(m_new, j, DiffNode::Modified);
+        child->m_oldSize = oldEntry.m_size;
+        child->m_totals.m_modified = 1;
+        if (newEntry.m_size > oldEntry.m_size)
+          child->m_totals.m_grown = newEntry.m_size - oldEntry.m_size;
+        else
+          child->m_totals.m_shrunk = oldEntry.m_size - newEntry.m_size;
+        Append(diff, std::move(child));
+      }
+
+      ++i;
+      ++j;
+    }
+  }
+
+private:
+  int CompareNames(quint32 oldIndex, quint32 newIndex) const
+  {
+    NameRef const l = m_old.m_entries[oldIndex].m_name;
+    NameRef const r = m_new.m_entries[newIndex].m_name;
+    return NamePool::CompareUnits(m_old.m_pool->Data(l), l.m_length, m_new.m_pool->Data(r), r.m_length);
+  }
+
+  static std::unique_ptr<DiffNode> MakeNode(ScanSnapshot const & snapshot, quint32 index, DiffNode::EChange change)
+  {
+    SnapshotEntry const & entry = snapshot.m_entries[index];
+    std::unique_ptr<DiffNode> node(new DiffNode());
+    node->m_name = snapshot.m_pool->Get(entry.m_name);
+    node->m_change = change;
+    node->m_isDir = entry.IsDir();
+    node->m_oldSize = change == DiffNode::Added ? 0 : entry.m_size;
+    node->m_newSize = change == DiffNode::Removed ? 0 : entry.m_size;
+    return node;
+  }
+
+  /// Added or removed entry, a directory is counted with its whole subtree
+  static void AddWhole(DiffNode * diff, ScanSnapshot const & snapshot, quint32 index, DiffNode::EChange change)
+  {
+    std::unique_ptr<DiffNode> node = MakeNode(snapshot, index, change);
+
+    quint64 count = 0;
+    qint64 size = 0;
+    std::vector<quint32> stack(1, index);
+    while (!stack.empty())
+    {
+      SnapshotEntry const & entry = snapshot.m_entries[stack.back()];
+      stack.pop_back();
+
+      ++count;
+      if (!entry.IsDir())
+        size += entry.m_size;
+
+      for (quint32 child = entry.m_firstChild; child < entry.m_firstChild + entry.m_childCount; ++child)
+        stack.push_back(child);
+    }
+
+    if (change == DiffNode::Added)
+    {
+      node->m_totals.m_added = count;
+      node->m_totals.m_grown = size;
+    }
+    else
+    {
+      node->m_totals.m_removed = count;
+      node->m_totals.m_shrunk = size;
+    }
+
+    Append(diff, std::move(node));
+  }
+
+  static void Append(DiffNode * parent, std::unique_ptr<DiffNode> && child)
+  {
+    child->m_parent = parent;
+    parent->m_children.push_back(std::move(child));
+  }
+
+  ScanSnapshot const & m_old;
+  ScanSnapshot const & m_new;
+};
+
+/// Takes pairs from the shared list until none is left, so big subtrees do not stall a thread
+class MergeWorker : public QRunnable
+{
+public:
+  MergeWorker(Differ const & differ, std::vector<DirPair> const & pairs, std::atomic<size_t> & next)
+    : m_differ(differ)
+    , m_pairs(pairs)
+    , m_next(next)
+  {
+    setAutoDelete(true);
+  }
+
+  void run()
+  {
+    for (size_t i = m_next++; i < m_pairs.size(); i = m_next++)
+      m_differ.MergeChildren(m_pairs[i].m_old, m_pairs[i].m_new, m_pairs[i].m_diff, nullptr);
+  }
+
+private:
+  Differ const & m_differ;
+  std::vector<DirPair> const & m_pairs;
+  std::atomic<size_t> & m_next;
+};
+
+/// Sums totals bottom up, drops directories without changes and numbers the rows
+void Finish(DiffNode * node)
+{
+  if (node->m_children.empty())
+    return;
+
+  std::vector<std::unique_ptr<DiffNode> > children;
+  children.swap(node->m_children);
+  for (std::unique_ptr<DiffNode> & child : children)
+  {
+    Finish(child.get());
+    if (child->m_change == DiffNode::Unchanged && child->m_totals.IsEmpty())
+      continue;
+
+    node->m_totals.m_added += child->m_totals.m_added;
+    node->m_totals.m_removed += child->m_totals.m_removed;
+    node->m_totals.m_modified += child->m_totals.m_modified;
+    node->m_totals.m_grown += child->m_totals.m_grown;
+    node->m_totals.m_shrunk += child->m_totals.m_shrunk;
+
+    child->m_row = static_cast<int>(node->m_children.size());
+    node->m_children.push_back(std::move(child));
+  }
+}
+
+} // namespace
+
+std::unique_ptr<DiffNode> DiffSnapshots(ScanSnapshot const & oldSnapshot, ScanSnapshot const & newSnapshot)
+{
+  std::unique_ptr<DiffNode> root(new DiffNode());
+  root->m_name = newSnapshot.m_rootPath;
+  root->m_isDir = true;
+  if (oldSnapshot.m_entries.empty() || newSnapshot.m_entries.empty() ||
+      !oldSnapshot.m_entries[0].IsListed() || !newSnapshot.m_entries[0].IsListed())
+    return root;
+
+  Differ differ(oldSnapshot, newSnapshot);
+
+  // level by level until there is enough independent work for every thread
+  size_t const threadCount = static_cast<size_t>(std::max(1, QThread::idealThreadCount()));
+  std::vector<DirPair> pairs(1, DirPair{ 0, 0, root.get() });
+  while (!pairs.empty() && pairs.size() < threadCount * PairsPerThread)
+  {
+    std::vector<DirPair> nextLevel;
+    for (DirPair const & pair : pairs)
+      differ.MergeChildren(pair.m_old, pair.m_new, pair.m_diff, &nextLevel);
+    pairs.swap(nextLevel);
+  }
+
+  // every pair writes only below its own node
+  QThreadPool pool;
+  pool.setMaxThreadCount(static_cast<int>(threadCount));
+  std::atomic<size_t> next(0);
+  for (size_t i = 0; i < std::min(threadCount, pairs.size()); ++i)
+    pool.start(new MergeWorker(differ, pairs, next));
+  pool.waitForDone();
+
+  Finish(root.get());
+  return root;
+}
+
+SnapshotDiffer::SnapshotDiffer(std::shared_ptr<ScanSnapshot> const & oldSnapshot, QString const & oldPath,
+                               std::shared_ptr<ScanSnapshot> const & newSnapshot, QString const & newPath)
+  : m_oldSnapshot(oldSnapshot)
+  , m_oldPath(oldPath)
+  , m_newSnapshot(newSnapshot)
+  , m_newPath(newPath)
+{
+}
+
+void SnapshotDiffer::run()
+{
+  QString error;
+  for (auto source : { std::make_pair(&m_oldSnapshot, &m_oldPath), std::make_pair(&m_newSnapshot, &m_newPath) })
+  {
+    if (*source.first != nullptr)
+    {
+      SortSnapshot(**source.first);
+      continue;
+    }
+
+    std::shared_ptr<ScanSnapshot> snapshot = std::make_shared<ScanSnapshot>();
+    if (!LoadSnapshot(*source.second, *snapshot, error))
+    {
+      emit diffFinished(nullptr, error, this);
+      return;
+    }
+
+    *source.first = snapshot;
+  }
+
+  std::unique_ptr<DiffNode> root = DiffSnapshots(*m_oldSnapshot, *m_newSnapshot);
+  emit diffFinished(root.release(), QString(), this);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "snapshot.hpp"
+
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <memory>
+#include <vector>
+
+/// Changes inside an entry, a directory sums up everything below it
+struct DiffTotals
+{
+  quint64 m_added = 0;
+  quint64 m_removed = 0;
+  quint64 m_modified = 0;
+  /// bytes of added and grown files
+  qint64 m_grown = 0;
+  /// bytes of removed and shrunk files
+  qint64 m_shrunk = 0;
+
+  bool IsEmpty() const
+  {
+    return m_added == 0 && m_removed == 0 && m_modified == 0;
+  }
+};
+
+/// Changed entry or a directory with changes below it
+struct DiffNode
+{
+  enum EChange
+  {
+    Unchanged,
+    Added,
+    Removed,
+    Modified
+  };
+
+  QString m_name;
+  EChange m_change = Unchanged;
+  bool m_isDir = false;
+  qint64 m_oldSize = 0;
+  qint64 m_newSize = 0;
+  DiffTotals m_totals;
+
+  DiffNode * m_parent = nullptr;
+  int m_row = 0;
+  std::vector<std::unique_ptr<DiffNode> > m_children;
+};
+
+Q_DECLARE_METATYPE(DiffNode *)
+
+/// Linear merge of name sorted children, subtrees below the first levels are compared in parallel.
+/// Content of a directory that was not listed in one of the snapshots is not compared.
+std::unique_ptr<DiffNode> DiffSnapshots(ScanSnapshot const & oldSnapshot, ScanSnapshot const & newSnapshot);
+
+/// Loads snapshots that are given by path and compares them on the thread pool
+class SnapshotDiffer : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  /// A null snapshot is loaded from its path
+  SnapshotDiffer(std::shared_ptr<ScanSnapshot> const & oldSnapshot, QString const & oldPath,
+                 std::shared_ptr<ScanSnapshot> const & newSnapshot, QString const & newPath);
+
+  /// root is null when error is not empty, the receiver takes ownership
+  Q_SIGNAL void diffFinished(DiffNode * root, QString const & error, SnapshotDiffer * differ);
+
+protected:
+  void run();
+
+private:
+  std::shared_ptr<ScanSnapshot> m_oldSnapshot;
+  QString m_oldPath;
+  std::shared_ptr<ScanSnapshot> m_newSnapshot;
+  QString m_newPath;
+};
@@ -0,0 +1,160 @@
+#include "stats_panel.hpp"
+#include "entry_info.hpp"
+#include "macros.hpp"
+#include "parallel_crawler.hpp"
+
+#include <QDateTime>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+/// Extensions beyond the largest ones are summed up in one row
+int const MaxExtensionRows = 50;
+
+QTreeWidgetItem * AddRow(QTreeWidgetItem * group, QString const & name, StatsBucket const & bucket, qint64 totalSize)
+{
+  QTreeWidgetItem * item = new QTreeWidgetItem(group);
+  item->setText(0, name);
+  item->setData(1, Qt::DisplayRole, bucket.m_count);
+  item->setData(2, Qt::DisplayRole, bucket.m_size);
+  double const share = totalSize > 0 ? 100.0 * bucket.m_size / totalSize : 0.0;
+  item->setText(3, QStringLiteral("%1%").arg(share, 0, 'f', 1));
+  for (int column = 1; column < 4; ++column)
+    item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+  return item;
+}
+
+/// Paths are shown relative to the crawled directory, activating the row opens the full one
+void AddTopRows(QTreeWidgetItem * group, QString const & rootPath, TopList const & top)
+{
+  QString const prefix = rootPath.endsWith('/') ? rootPath : rootPath + '/';
+  for (TopEntry const & entry : top.Sorted())
+  {
+    QTreeWidgetItem * item = new QTreeWidgetItem(group);
+    item->setText(0, entry.m_path == rootPath ? QStringLiteral(".") : entry.m_path.mid(prefix.size()));
+    item->setToolTip(0, entry.m_path);
+    item->setData(0, Qt::UserRole, entry.m_path);
+    item->setData(1, Qt::DisplayRole, entry.m_count);
+    item->setData(2, Qt::DisplayRole, entry.m_size);
+    if (entry.m_modifiedTime != EntryInfo::InvalidTime)
+      item->setData(4, Qt::DisplayRole, QDateTime::fromMSecsSinceEpoch(entry.m_modifiedTime));
+    for (int column = 1; column < 3; ++column)
+      item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+  }
+}
+
+template <typename TKey>
+std::vector<std::pair<TKey, StatsBucket> > SortBySize(QHash<TKey, StatsBucket> const & buckets)
+{
+  std::vector<std::pair<TKey, StatsBucket> > sorted;
+  sorted.reserve(buckets.size());
+  for (typename QHash<TKey, StatsBucket>::const_iterator it = buckets.begin(); it != buckets.end(); ++it)
+    sorted.push_back(std::make_pair(it.key(), it.value()));
+
+  std::sort(sorted.begin(), sorted.end(), [](std::pair<TKey, StatsBucket> const & l, std::pair<TKey, StatsBucket> const & r)
+  {
+    return l.second.m_size > r.second.m_size;
+  });
+
+  return sorted;
+}
+
+} // namespace
+
+StatsPanel::StatsPanel(QWidget * parent)
+  : TBase(QStringLiteral("Statistics"), parent)
+{
+  setObjectName(QStringLiteral("StatsPanel"));
+
+  QWidget * content = new QWidget(this);
+  m_summary = new QLabel(content);
+  m_summary->setWordWrap(true);
+  m_view = new QTreeWidget(content);
+  m_view->setHeaderLabels(QStringList() << QStringLiteral("Group") << QStringLiteral("Files")
+                                        << QStringLiteral("Bytes") << QStringLiteral("Share")
+                                        << QStringLiteral("Modified"));
+  m_view->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+  m_view->header()->setStretchLastSection(false);
+
+  QVBoxLayout * layout = new QVBoxLayout(content);
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->addWidget(m_summary);
+  layout->addWidget(m_view);
+  setWidget(content);
+
+  VERIFY(QObject::connect(m_view, &QTreeWidget::itemActivated, this, &StatsPanel::onItemActivated));
+}
+
+void StatsPanel::setStats(QString const & path, CrawlStats const & stats, bool finished)
+{
+  QString const state = finished ? QStringLiteral("done") : QStringLiteral("crawling...");
+  m_summary->setText(QStringLiteral("%1\n%2 files, %3 bytes in %4 directories, %5 not readable (%6)\n"
+                                    "%7 hard links (%8 bytes) counted once, skipped: %9 links, %10 mount points, %11 revisited directories")
+                     .arg(path).arg(stats.m_total.m_count).arg(stats.m_total.m_size)
+                     .arg(stats.m_dirCount).arg(stats.m_errorCount).arg(state)
+                     .arg(stats.m_duplicates.m_count).arg(stats.m_duplicates.m_size)
+                     .arg(stats.m_skippedLinks).arg(stats.m_skippedMounts).arg(stats.m_revisitedDirs));
+
+  std::vector<bool> isExpanded;
+  for (int i = 0; i < m_view->topLevelItemCount(); ++i)
+    isExpanded.push_back(m_view->topLevelItem(i)->isExpanded());
+
+  m_view->setUpdatesEnabled(false);
+  m_view->clear();
+  qint64 const totalSize = stats.m_total.m_size;
+
+  QTreeWidgetItem * extensions = new QTreeWidgetItem(m_view, QStringList(QStringLiteral("By extension")));
+  StatsBucket otherExtensions;
+  int row = 0;
+  for (auto const & extension : SortBySize(stats.m_byExtension))
+  {
+    if (row++ < MaxExtensionRows)
+      AddRow(extensions, extension.first.isEmpty() ? QStringLiteral("(none)") : extension.first, extension.second, totalSize);
+    else
+      otherExtensions.Merge(extension.second);
+  }
+  if (otherExtensions.m_count > 0)
+    AddRow(extensions, QStringLiteral("(other)"), otherExtensions, totalSize);
+
+  QTreeWidgetItem * owners = new QTreeWidgetItem(m_view, QStringList(QStringLiteral("By owner")));
+  for (auto const & owner : SortBySize(stats.m_byOwner))
+  {
+    QString const name = GetOwnerName(owner.first);
+    AddRow(owners, name.isEmpty() ? QString::number(owner.first) : name, owner.second, totalSize);
+  }
+
+  static char const * const ageNames[CrawlStats::AgeCount] =
+  {
+    "Last day", "Last week", "Last month", "Last 3 months", "Last year", "Last 3 years", "Older", "Unknown"
+  };
+
+  QTreeWidgetItem * ages = new QTreeWidgetItem(m_view, QStringList(QStringLiteral("By modification age")));
+  for (int age = 0; age < CrawlStats::AgeCount; ++age)
+    AddRow(ages, QString::fromLatin1(ageNames[age]), stats.m_byAge[age], totalSize);
+
+  QTreeWidgetItem * largestFiles = new QTreeWidgetItem(m_view, QStringList(QStringLiteral("Largest files")));
+  AddTopRows(largestFiles, path, stats.m_largestFiles);
+  QTreeWidgetItem * oldestFiles = new QTreeWidgetItem(m_view, QStringList(QStringLiteral("Oldest files")));
+  AddTopRows(oldestFiles, path, stats.m_oldestFiles);
+  QTreeWidgetItem * largestDirs = new QTreeWidgetItem(m_view, QStringList(QStringLiteral("Largest directories by own files")));
+  AddTopRows(largestDirs, path, stats.m_largestDirs);
+
+  for (int i = 0; i < m_view->topLevelItemCount(); ++i)
+    m_view->topLevelItem(i)->setExpanded(i < static_cast<int>(isExpanded.size()) ? isExpanded[i] : true);
+
+  m_view->setUpdatesEnabled(true);
+}
+
+void StatsPanel::onItemActivated(QTreeWidgetItem * item, int /*column*/)
+{
+  QString const path = item->data(0, Qt::UserRole).toString();
+  if (!path.isEmpty())
+    emit pathActivated(path);
+}
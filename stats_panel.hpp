@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QDockWidget>
+
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+struct CrawlStats;
+
+/// Bytes and file counts below a directory by extension, owner and age, and the largest and oldest
+/// files and directories, filled by ParallelCrawler reports
+class StatsPanel : public QDockWidget
+{
+  Q_OBJECT
+
+  using TBase = QDockWidget;
+public:
+  explicit StatsPanel(QWidget * parent = 0);
+
+  /// Rebuilds the view on every report, groups the user expanded stay expanded
+  void setStats(QString const & path, CrawlStats const & stats, bool finished);
+
+  /// A row of a top list was activated
+  Q_SIGNAL void pathActivated(QString const & path);
+
+private:
+  Q_SLOT void onItemActivated(QTreeWidgetItem * item, int column);
+
+private:
+  QLabel * m_summary;
+  QTreeWidget * m_view;
+};
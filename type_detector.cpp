@@ -0,0 +1,85 @@
+#include "type_detector.hpp"
+
+#include <QFile>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QReadWriteLock>
+#include <QVector>
+
+namespace
+{
+
+/// Enough for the magic rules of common formats
+qint64 const SniffSize = 512;
+
+QReadWriteLock s_typesLock;
+QHash<QString, quint16> s_typeIds;
+QVector<QString> s_typeNames = { QString(), QString() };
+
+quint16 DetectType(QMimeDatabase const & database, TypeRequest const & request)
+{
+  QString const fileName = request.m_path.mid(request.m_path.lastIndexOf('/') + 1);
+  QList<QMimeType> const types = database.mimeTypesForFileName(fileName);
+  if (types.size() == 1 || (!types.isEmpty() && !request.m_canRead))
+    return RegisterType(types.front().name());
+
+  // no extension or one that several types share
+  if (request.m_canRead)
+  {
+    QFile file(request.m_path);
+    if (file.open(QIODevice::ReadOnly))
+      return RegisterType(database.mimeTypeForFileNameAndData(fileName, file.read(SniffSize)).name());
+  }
+
+  return RegisterType(database.mimeTypeForName(QStringLiteral("application/octet-stream")).name());
+}
+
+} // namespace
+
+quint16 RegisterType(QString const & mimeName)
+{
+  {
+    QReadLocker lock(&s_typesLock);
+    QHash<QString, quint16>::const_iterator it = s_typeIds.constFind(mimeName);
+    if (it != s_typeIds.constEnd())
+      return it.value();
+  }
+
+  QWriteLocker lock(&s_typesLock);
+  QHash<QString, quint16>::const_iterator it = s_typeIds.constFind(mimeName);
+  if (it != s_typeIds.constEnd())
+    return it.value();
+
+  // the database knows about a thousand types, far from the limit
+  quint16 const typeId = static_cast<quint16>(s_typeNames.size());
+  s_typeNames.append(mimeName);
+  s_typeIds.insert(mimeName, typeId);
+  return typeId;
+}
+
+QString GetTypeName(quint16 typeId)
+{
+  QReadLocker lock(&s_typesLock);
+  return typeId < s_typeNames.size() ? s_typeNames[typeId] : QString();
+}
+
+TypeDetector::TypeDetector(std::vector<TypeRequest> && requests)
+  : m_requests(std::move(requests))
+{
+}
+
+void TypeDetector::run()
+{
+  QMimeDatabase database;
+  TypeBatch batch;
+  batch.m_results.reserve(m_requests.size());
+  for (TypeRequest const & request : m_requests)
+  {
+    TypeResult result;
+    result.m_path = request.m_path;
+    result.m_typeId = DetectType(database, request);
+    batch.m_results.push_back(result);
+  }
+
+  emit typesDetected(batch, this);
+}
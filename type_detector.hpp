@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+
+#include <vector>
+
+/// Type ids are compact and stable while the program runs, any thread may register or read them
+quint16 const UnknownType = 0;
+/// Requested, the detector has not answered yet
+quint16 const PendingType = 1;
+
+quint16 RegisterType(QString const & mimeName);
+QString GetTypeName(quint16 typeId);
+
+struct TypeRequest
+{
+  QString m_path;
+  /// archive members can only be told by name
+  bool m_canRead = true;
+};
+
+struct TypeResult
+{
+  QString m_path;
+  quint16 m_typeId = UnknownType;
+};
+
+struct TypeBatch
+{
+  std::vector<TypeResult> m_results;
+};
+
+Q_DECLARE_METATYPE(TypeBatch)
+
+/// Tells file types by name first and reads the first bytes only when the name is not enough
+class TypeDetector : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  explicit TypeDetector(std::vector<TypeRequest> && requests);
+
+  Q_SIGNAL void typesDetected(TypeBatch const & batch, TypeDetector * detector);
+
+protected:
+  void run();
+
+private:
+  std::vector<TypeRequest> m_requests;
+};